@@ -17,13 +17,24 @@ int main(int argc, char *argv[])
             config.transpositionTableMBs = std::stoi(argv[i + 1]);
             i++;
         }
+        else if ((arg == "-threads" || arg == "--threads") && i + 1 < argc)
+        {
+            config.threads = std::stoi(argv[i + 1]);
+            i++;
+        }
     }
 
     chess::Engine engine(config);
     while (!engine.hasQuit())
     {
         std::string cmd;
-        getline(std::cin, cmd);
+        // Searches run on the engine's search thread, so we can keep reading commands (like stop) while it thinks
+        if (!getline(std::cin, cmd))
+        {
+            // The input was closed, a search that was already started (with a limit) still gives its answer
+            engine.finishSearch();
+            cmd = "quit";
+        }
         engine.runCmd(cmd);
     }
 }
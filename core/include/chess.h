@@ -144,6 +144,44 @@ namespace chess
         Move moves[MAX_MOVES];
     };
 
+    /*
+     * Evaluation terms that are updated incrementally whenever a piece is moved, added or removed
+     * (in movePiece and togglePiece), so the evaluation doesn't need to loop over all the pieces.
+     */
+    struct EvalState
+    {
+        // Piece square table scores (white - black)
+        score middleGameScore;
+        score endGameScore;
+
+        // Material of the pieces (excluding pawns and the king), indexed by color (0 black 1 white)
+        score pieceMaterial[2];
+        // Number of pieces of each type (excluding the king), indexed by color (0 black 1 white)
+        uint8_t pieceCounts[2][5];
+
+        // Zobrist key of only the pawns (used to index the pawn hash table)
+        key pawnKey;
+
+        bool operator==(const EvalState &other) const = default;
+    };
+
+    /*
+     * Everything needed to undo a move that can't be derived from the move itself.
+     * Returned by BoardState::makeMove and passed back to BoardState::unmakeMove.
+     */
+    struct UndoInfo
+    {
+        key hash;
+        PieceType capturedPiece; // None for quiet moves and en passant captures
+        square enpassentSquare;
+        uint8_t castleRights;
+        uint8_t pliesSince50MoveRuleReset;
+        EvalState evalState;
+    };
+
+    // Per call state of the move generation (see chessMoveGen.cpp)
+    struct MoveGenContext;
+
     class BoardState
     {
     public:
@@ -158,30 +196,56 @@ namespace chess
 
         enum MoveGenType
         {
-            Normal,
-            Quiescent
+            Normal,        // all pseudo legal moves
+            Quiescent,     // only pseudo legal captures
+            Legal,          // all legal moves (generated using check and pin masks)
+            LegalQuiescent, // only legal captures
+            LegalQuiet      // only legal non captures (including castling and non capturing promotions)
         };
 
         /**
          * @brief returns pseudo legal moves from the current position
          *
-         * Pseudo legal means we don't consider wether we put ourselfs in check
+         * Pseudo legal means we don't consider wether we put ourselfs in check.
+         * For the Legal, LegalQuiescent and LegalQuiet gen types only legal moves are generated, so no
+         * kingAttacked check is needed after making the move.
          *
          * @return the moves
          */
         template <MoveGenType GenType>
         MoveList pseudoLegalMoves() const;
 
+        // Same as pseudoLegalMoves but adds the moves to the given list
+        // (avoids copying the move list when it is stored, like in the MovePicker)
+        template <MoveGenType GenType>
+        void generateMoves(MoveList &moves) const;
+
         /**
          * @brief returns the legal moves in the position
          *
-         * This performs each pseudo legal move and checks wether it puts us in check.
+         * (equivalent to pseudoLegalMoves<MoveGenType::Legal>())
          *
          * @return the moves
          */
         MoveList legalMoves() const;
 
-        void makeMove(const Move &move);
+        // Wether the move is legal in this position (only generates the moves of the moved piece)
+        // Used to verify moves that don't come from the move generation (like the transposition table move)
+        bool isLegalMove(const Move &move) const;
+
+        // Makes the move and returns the info needed to undo it
+        // (the result can be ignored when copying the board before making the move)
+        UndoInfo makeMove(const Move &move);
+
+        // Reverts makeMove, the move and undo info should be those of the last made move
+        void unmakeMove(const Move &move, const UndoInfo &undo);
+
+        // Passes the turn to the opponent without moving a piece (used for null move pruning)
+        // Only the side to move, en passant square and 50 move counter (and the hash) change.
+        UndoInfo makeNullMove();
+
+        // Reverts makeNullMove
+        void unmakeNullMove(const UndoInfo &undo);
 
         const bitboard *getPieceSet(bool white) const { return white ? m_whitePieces : m_blackPieces; }
         inline bitboard allPieces(bool white) const { return white ? whitePieces() : blackPieces(); }
@@ -220,6 +284,20 @@ namespace chess
         bool squareAttacked(square s) const;
         bool kingAttacked(bool white) const;
 
+        // Returns the pieces of both colors that attack square s when only the pieces in occupancy are on the board.
+        // (removing a piece from the occupancy reveals the sliders behind it)
+        bitboard attackersTo(square s, bitboard occupancy) const;
+
+        /**
+         * @brief Static exchange evaluation of a move
+         *
+         * Plays out all captures on the target square of the move, where both sides always capture
+         * with their least valuable attacker and can stop capturing whenever that is better for them.
+         *
+         * @return the material (in centipawns) the side to move wins with the move (negative when it loses material)
+         */
+        int staticExchangeEval(const Move &move) const;
+
         inline bool whitesMove() const { return m_whitesMove; }
 
         inline bitboard whitePieces() const
@@ -248,6 +326,12 @@ namespace chess
         // NOTE: this should not be used outside of testing purposes
         void recomputeHash();
 
+        inline const EvalState &evalState() const { return m_evalState; }
+        inline key getPawnKey() const { return m_evalState.pawnKey; }
+
+        // Same as recomputeHash but for the incrementally updated evaluation terms
+        void recomputeEvalState();
+
         template <bool white>
         PieceType pieceOnSquare(square s) const;
 
@@ -277,32 +361,35 @@ namespace chess
         // Zobrist hash of the current board state
         key m_hash;
 
+        // Incrementally updated terms for the evaluation
+        EvalState m_evalState;
+
     private:
         // Piece specific move generation helpers
         template <MoveGenType GenT>
-        void genPawnMoves(MoveList &outMoves) const;
+        void genPawnMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
         template <MoveGenType GenT>
-        void genKnightMoves(MoveList &outMoves) const;
+        void genKnightMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
         template <MoveGenType GenT>
-        void genBishopMoves(MoveList &outMoves) const;
+        void genBishopMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
         template <MoveGenType GenT>
-        void genRookMoves(MoveList &outMoves) const;
+        void genRookMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
         template <MoveGenType GenT>
-        void genQueenMoves(MoveList &outMoves) const;
+        void genQueenMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
         template <MoveGenType GenT>
-        void genKingMoves(MoveList &outMoves) const;
+        void genKingMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
 
         // helpers to generate the castling moves
-        void genCastlingMoves(MoveList &outMoves) const;
-        void tryCastle(MoveList &outMoves, bool shortCastle) const;
+        void genCastlingMoves(MoveList &outMoves, const MoveGenContext &ctx) const;
+        void tryCastle(MoveList &outMoves, bool shortCastle, const MoveGenContext &ctx) const;
 
         // helper which adds all moves positions specified in a bitboard
         template <MoveGenType GenT>
-        inline void addMoves(bitboard moves, square curPos, PieceType piece, MoveList &outMoves) const;
+        inline void addMoves(bitboard moves, square curPos, PieceType piece, MoveList &outMoves, const MoveGenContext &ctx) const;
 
-        // makeMove templated
+        // makeMove templated (returns the captured piece)
         template <bool whitesMove>
-        void makeMove(const Move &move);
+        PieceType makeMove(const Move &move);
 
         // Piece specific move making helpers
         template <bool whitesMove>
@@ -4,6 +4,14 @@
 #include <string>
 #include <tuple>
 #include <optional>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <vector>
+#include <sstream>
 #include "chess.h"
 #include "search.h"
 #include "eval.h"
@@ -21,18 +29,28 @@ namespace chess
         {
             // Default
             EngineConfig()
-                : transpositionTableMBs(64) {};
+                : transpositionTableMBs(64), threads(1) {};
             // Default 64 mb table
             int transpositionTableMBs;
+            // Number of search threads (1 main thread + threads - 1 lazy SMP helpers)
+            int threads;
         };
 
         // Always need a "default config"
         Engine(EngineConfig config = EngineConfig())
-            : m_quit(false), m_transTable(config.transpositionTableMBs)
+            : m_quit(false), m_threads(std::max(1, config.threads)),
+              m_transTable(config.transpositionTableMBs)
         {
         }
 
+        // Stops a running search, the search thread and the lazy SMP helper threads
+        ~Engine();
+
+        Engine(const Engine &) = delete;
+        Engine &operator=(const Engine &) = delete;
+
         // The main way users will interface with the engine
+        // NOTE: searches (go and bestMove) run on the search thread, so their output is printed after runCmd returns
         void runCmd(std::string cmd);
 
         bool hasQuit() { return m_quit; }
@@ -54,6 +72,9 @@ namespace chess
         // Returns false if move is illegal
         bool makeMove(std::string uciMove)
         {
+            // The search uses the board and repetition table
+            finishSearch();
+
             Move chosenMove = Move::Null();
             // Find the chosen move
             for (auto &m : m_currentBoard.legalMoves())
@@ -82,26 +103,52 @@ namespace chess
         }
 
         // Returns the best found move, evaluation (int), max completed depth (int)
-        std::tuple<Move, Eval, Search::SearchStats> findBestMove(Time thinkTime)
-        {
-            Search::SearchConfig config;
-            config.evalFunction = Evaluator::evaluate;
-            config.repTable = &m_repTable;
-            config.transTable = &m_transTable;
+        // When multiple threads are configured the search is done using lazy SMP (see lazySMP.cpp)
+        // (a think time can be passed to search for a fixed time)
+        // onIteration is called after every completed iteration of the main search
+        std::tuple<Move, Eval, Search::SearchStats> findBestMove(SearchLimits limits,
+                                                                Search::IterationCallback onIteration = nullptr);
+
+        using SearchResultCallback = std::function<void(Move, Eval, const Search::SearchStats &)>;
+
+        // Runs findBestMove on the search thread (started on the first search) and returns immediately.
+        // onDone is called on the search thread with the results. Waits for a still running search first.
+        // An infinite search only reports its result once it is stopped.
+        void startSearch(SearchLimits limits, SearchResultCallback onDone,
+                         Search::IterationCallback onIteration = nullptr);
+
+        // Stops the running search (if any), its results are still reported through the callback
+        void stopSearch();
+
+        // Blocks until the running search (if any) is done
+        void waitForSearch();
 
-            Search s(m_currentBoard, config);
-            return s.iterativeDeepening(thinkTime);
+        // Waits for the running search (if any) to finish, an infinite search is stopped first since only stop ends it
+        void finishSearch();
+
+        bool searching()
+        {
+            std::lock_guard<std::mutex> lock(m_searchMutex);
+            return m_searching;
         }
 
         BoardState board() const { return m_currentBoard; }
         void setPosition(BoardState b)
         {
+            finishSearch();
             m_currentBoard = b;
 
             m_transTable.clear();
             m_repTable.clear();
         }
 
+        // Resizes the transposition table (this clears all its entries)
+        void setTranspositionTableSize(int mbSize)
+        {
+            finishSearch();
+            m_transTable.resize(mbSize);
+        }
+
         enum class BenchType
         {
             Depth
@@ -110,21 +157,73 @@ namespace chess
         struct BenchResult
         {
             double seconds;
-            int searchedNodes;
+            uint64_t searchedNodes;
             int depth;
+            uint64_t betaCutOffs;
+            uint64_t firstMoveCutOffs;
         };
 
         template <BenchType benchType>
         std::optional<BenchResult> bench(double quantity);
 
     private:
+        // The UCI commands with their arguments (see uci.cpp)
+        void uciCmd();
+        void positionCmd(std::istringstream &args);
+        void setOptionCmd(std::istringstream &args);
+        // Parses the arguments of the go command and starts the search (shared by UCI and the custom commands)
+        void goCmd(std::istringstream &args);
+
         bool m_quit;
+        // Set by the uci command, go then reports an info line for every iteration (instead of a single summary)
+        bool m_uciMode = false;
+        int m_threads;
         BoardState m_currentBoard;
 
         // If we have 100 previous states then the 50 move rule aplies
         // Note that we store a version of the hash which does not contain any enpassant key.
         RepetitionTable m_repTable;
         TranspositionTable m_transTable;
+
+        // The persistent search thread, which runs the searches started by startSearch
+        void searchThreadLoop();
+
+        std::thread m_searchThread;
+        std::mutex m_searchMutex;
+        std::condition_variable m_searchCondition;
+        // The search to run next on the search thread (empty when there is none)
+        std::function<void()> m_searchJob;
+        bool m_searching = false;
+        // Wether the running search is infinite
+        bool m_searchInfinite = false;
+        bool m_shutdown = false;
+
+        // The nodes searched by the lazy SMP helpers of the running search (see SearchConfig::helperNodes)
+        std::atomic<uint64_t> m_helperNodes = 0;
+
+        // The persistent lazy SMP helper threads (see lazySMP.cpp), which run a helper search for every search
+        void helperThreadLoop(int helperIdx);
+
+        std::vector<std::thread> m_helperThreads;
+        std::mutex m_helperMutex;
+        std::condition_variable m_helperCondition;
+        // Increased for every search with helpers, so the helpers can tell a new search from a spurious wake up
+        uint64_t m_helperSearchId = 0;
+        // The helpers taking part in the current search (the first m_threads - 1) and how many of those are still searching
+        int m_activeHelpers = 0;
+        int m_runningHelpers = 0;
+        std::optional<SearchLimits> m_helperLimits;
+        // A copy of the repetition table for every helper (the search adds and pops states on it)
+        std::vector<RepetitionTable> m_helperRepTables;
+        // The searches of the helpers while they run (so they can be stopped) and their stats once they are done
+        std::vector<Search *> m_helperSearches;
+        std::vector<Search::SearchStats> m_helperStats;
+        bool m_helpersStopped = false;
+        bool m_helperShutdown = false;
+
+        // The main search of findBestMove while it runs (so stopSearch can reach it)
+        Search *m_mainSearch = nullptr;
+        bool m_stopRequested = false;
     };
 
 }
@@ -3,6 +3,7 @@
 #include "chess.h"
 #include "limits.h"
 #include <iostream>
+#include <vector>
 
 #include "types.h"
 
@@ -24,6 +25,60 @@ namespace chess
         OPEN = HALF_OPEN_BLACK | HALF_OPEN_WHITE // no pawns at all
     };
 
+    // The parts of the evaluation that only depend on the pawns (cached in the PawnHashTable)
+    // NOTE: the default is the structure without any pawns (which has a pawn key of 0)
+    struct PawnStructure
+    {
+        key pawnKey = 0;
+
+        // pawnStructureAnalysis score of the pawns that aren't passed, indexed by color (0 black 1 white)
+        // (the passed pawn bonus depends on the endgameness, so it is added during the evaluation)
+        score structureScore[2] = {0, 0};
+        bitboard passedPawns[2] = {0, 0};
+
+        FileType fileTypes[8] = {FileType::OPEN, FileType::OPEN, FileType::OPEN, FileType::OPEN,
+                                 FileType::OPEN, FileType::OPEN, FileType::OPEN, FileType::OPEN};
+    };
+
+    // Fills the pawn structure for the pawns on the board
+    void analyzePawnStructure(const BoardState &b, PawnStructure &out);
+
+    /*
+     * Fixed size cache of the pawn structures, indexed by the pawn key of the board.
+     * The pawns rarely change during a search, so most evaluations can reuse an earlier analysis.
+     * NOTE: not thread safe, every search (thread) has its own table.
+     */
+    class PawnHashTable
+    {
+    public:
+        static constexpr size_t NUM_ENTRIES = 1 << 14; // (~640KB)
+
+        PawnHashTable() : m_entries(NUM_ENTRIES) {}
+
+        // Returns the pawn structure of the board (analyzing it when it isn't in the table yet)
+        inline const PawnStructure &get(const BoardState &b)
+        {
+            key pawnKey = b.getPawnKey();
+            PawnStructure &entry = m_entries[pawnKey & (NUM_ENTRIES - 1)];
+
+            m_probes++;
+            if (entry.pawnKey == pawnKey)
+                m_hits++;
+            else
+                analyzePawnStructure(b, entry);
+
+            return entry;
+        }
+
+        uint64_t probes() const { return m_probes; }
+        uint64_t hits() const { return m_hits; }
+
+    private:
+        std::vector<PawnStructure> m_entries;
+        uint64_t m_probes = 0;
+        uint64_t m_hits = 0;
+    };
+
     // A class used to encapsulate all the data used during the evaluation process
     class Evaluator
     {
@@ -31,13 +86,23 @@ namespace chess
         // The main way to evaluate a position
         static score evaluate(const BoardState &b)
         {
-            Evaluator evaluator(b);
+            // Without a table the pawn structure is analyzed for this evaluation only
+            PawnStructure pawns;
+            analyzePawnStructure(b, pawns);
+            Evaluator evaluator(b, pawns);
+            return evaluator.evaluation();
+        }
+
+        // Same as above, but looks up the pawn structure in (and adds it to) the pawn hash table
+        static score evaluate(const BoardState &b, PawnHashTable &pawnTable)
+        {
+            Evaluator evaluator(b, pawnTable.get(b));
             return evaluator.evaluation();
         }
 
         Evaluator() = delete;
-        Evaluator(const BoardState &position)
-            : m_board(position)
+        Evaluator(const BoardState &position, const PawnStructure &pawns)
+            : m_board(position), m_pawns(pawns)
         {
             // Ensure all variables stored in the class are initialized
 
@@ -53,9 +118,6 @@ namespace chess
 
             // set middleGameScore and endGameScore
             calculatePieceSquareTableScores();
-
-            // set fileTypes
-            determineOpenFiles();
         }
 
         score evaluation();
@@ -69,7 +131,6 @@ namespace chess
         }
 
     private:
-        void determineOpenFiles();
         float mopUpFactor(); // [0, 1] wether to use mopup score
         score mopUpScore();
 
@@ -94,12 +155,15 @@ namespace chess
 
     private:
         const BoardState &m_board;
+        // The (possibly cached) analysis of the pawns, includes the file types
+        const PawnStructure &m_pawns;
 
         const bitboard *m_whiteBitBoards;
         const bitboard *m_blackBitBoards;
 
-        uint8_t m_whitePieceCounts[5];
-        uint8_t m_blackPieceCounts[5];
+        // (point into the incrementally updated evaluation terms of the board)
+        const uint8_t *m_whitePieceCounts;
+        const uint8_t *m_blackPieceCounts;
         score m_whitePieceMaterial;
         score m_blackPieceMaterial;
 
@@ -109,8 +173,6 @@ namespace chess
         // Piece square table scores
         score m_middleGameScore;
         score m_endGameScore;
-
-        FileType m_fileTypes[8];
     };
 
     // fileType helpers
@@ -156,6 +218,14 @@ namespace chess
                 throw std::runtime_error("Eval is not a mate");
         }
 
+        score scoreValue() const
+        {
+            if (type == SCORE)
+                return scoreVal;
+            else
+                throw std::runtime_error("Eval is a mate");
+        }
+
     private:
         union
         {
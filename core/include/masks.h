@@ -1,3 +1,5 @@
+#pragma once
+
 #include "bitBoard.h"
 #include "types.h"
 
@@ -152,4 +154,70 @@ namespace chess::mask
 
         return squareMask;
     }
+
+    namespace detail
+    {
+        struct LineTables
+        {
+            bitboard between[64][64];
+            bitboard line[64][64];
+        };
+
+        // Walks from a in every direction and fills in the tables for each square b we encounter
+        constexpr LineTables computeLineTables()
+        {
+            LineTables tables = {};
+            constexpr int directions[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+            for (int a = 0; a < 64; a++)
+            {
+                for (auto [dRank, dFile] : directions)
+                {
+                    // The full line (both directions) through a
+                    bitboard fullLine = 1ULL << a;
+                    for (int sign : {1, -1})
+                    {
+                        int rank = a / 8 + sign * dRank;
+                        int file = a % 8 + sign * dFile;
+                        while (bitBoards::inBounds(rank, file))
+                        {
+                            fullLine |= 1ULL << (rank * 8 + file);
+                            rank += sign * dRank;
+                            file += sign * dFile;
+                        }
+                    }
+
+                    bitboard betweenSquares = 0;
+                    int rank = a / 8 + dRank;
+                    int file = a % 8 + dFile;
+                    while (bitBoards::inBounds(rank, file))
+                    {
+                        int b = rank * 8 + file;
+                        tables.between[a][b] = betweenSquares;
+                        tables.line[a][b] = fullLine;
+
+                        betweenSquares |= 1ULL << b;
+                        rank += dRank;
+                        file += dFile;
+                    }
+                }
+            }
+
+            return tables;
+        }
+
+        inline constexpr LineTables lineTables = computeLineTables();
+    }
+
+    // The squares strictly between a and b (0 if they are not on the same rank, file or diagonal)
+    constexpr bitboard between(square a, square b)
+    {
+        return detail::lineTables.between[a][b];
+    }
+
+    // The entire rank, file or diagonal through a and b (0 if they are not aligned)
+    constexpr bitboard line(square a, square b)
+    {
+        return detail::lineTables.line[a][b];
+    }
 }
\ No newline at end of file
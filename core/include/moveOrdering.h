@@ -3,10 +3,16 @@
  * This file contains all the definitions for the "moveTables" that are used to improve the move ordering.
  * This includes the following tables:
  *  - History table
+ *  - Killer moves (per ply)
+ *  - Countermove table (the quiet move that refuted the previous move)
+ *  - Continuation history (history of a quiet move given the previous move)
+ *
+ * Additionally it contains the MovePicker which hands out the moves of a position in order.
  */
 
 #include "chess.h"
 #include <algorithm>
+#include <vector>
 
 namespace chess
 {
@@ -29,51 +35,157 @@ namespace chess
 
         static constexpr score TABLE_MAX = SCORE_MAX - 3000;
 
+        // The number of killer moves stored per ply
+        static constexpr int NUM_KILLERS = 2;
+
         MoveScorer()
+            // (too large to keep inside the search object which can live on the stack)
+            : m_continuationHistory(2 * NUM_MOVES * NUM_MOVES, 0)
         {
-            memset(&m_historyTable[0], SCORE_MIN, sizeof(m_historyTable));
+            memset(&m_historyTable[0], 0, sizeof(m_historyTable));
+            std::fill(&m_killers[0][0], &m_killers[0][0] + MAX_SEARCH_DEPTH * NUM_KILLERS, Move::Null());
+            std::fill(&m_counterMoves[0][0], &m_counterMoves[0][0] + 2 * NUM_MOVES, Move::Null());
         }
 
         // Gives a rough heuristic based on which we can order the moves in our search
         // Put in this class because we can use info from the search to help the ordering
-        score moveScore(Move move, const BoardState &board) const;
+        // (prevMove is the move that lead to the board, Null in the root or after a null move)
+        score moveScore(Move move, const BoardState &board, Move prevMove) const;
 
-        void registerBetaCutOff(Move m, bool whitesMove, uint8_t remainingDepth)
+        void registerBetaCutOff(Move m, bool whitesMove, uint8_t remainingDepth, uint8_t ply, Move prevMove)
         {
             // We only register the move in our tables if it is a quiet move
             if (!m.isQuiet())
                 return;
 
             uint16_t idx = moveIdx(m);
-            score bonus = remainingDepth * remainingDepth;
+            uint16_t prevIdx = moveIdx(prevMove);
+            int bonus = remainingDepth * remainingDepth;
+
+            // update history tables
+            addBonus(m_historyTable[whitesMove][idx], bonus);
+            addBonus(continuationEntry(whitesMove, prevIdx, idx), bonus);
+
+            // update the killers (most recent first)
+            Move *killers = m_killers[ply];
+            if (killers[0] != m)
+            {
+                killers[1] = killers[0];
+                killers[0] = m;
+            }
+
+            m_counterMoves[whitesMove][prevIdx] = m;
+        }
+
+        // How often (weighted by depth) the quiet move caused a beta cutoff
+        score historyScore(Move m, bool whitesMove) const { return m_historyTable[whitesMove][moveIdx(m)]; }
+
+        // The quiet moves that caused a beta cutoff in a sibling node (on the same ply)
+        const Move *killers(uint8_t ply) const { return m_killers[ply]; }
+
+        // The quiet move that last caused a beta cutoff as a reply to prevMove
+        Move counterMove(Move prevMove, bool whitesMove) const { return m_counterMoves[whitesMove][moveIdx(prevMove)]; }
+
+    private:
+        static void addBonus(score &entry, int bonus)
+        {
+            entry = std::min(entry + bonus, (int)TABLE_MAX);
+        }
 
-            // update history table
-            m_historyTable[whitesMove][idx] += bonus;
-            m_historyTable[whitesMove][idx] = std::min(m_historyTable[whitesMove][idx], TABLE_MAX);
+        score &continuationEntry(bool whitesMove, uint16_t prevIdx, uint16_t idx)
+        {
+            return m_continuationHistory[(whitesMove * NUM_MOVES + prevIdx) * NUM_MOVES + idx];
         }
 
-        // Orders the moves in the move list
-        // We also use the transposition table to get the best move
-        // from the previous search and put it at the front of the list
-        // additionally for countermove heuristic we also need the previous move
-        void orderMoves(MoveList &moves, const BoardState &board, Move TTMove)
+        score continuationEntry(bool whitesMove, uint16_t prevIdx, uint16_t idx) const
         {
-            std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &b)
-                      {
-                // Check if the move is the best move from the transposition table
-                if (a == TTMove)
-                return true;
-                
-                if (b == TTMove)
-                return false;
-                
-                // If not, we sort the moves based on their score
-                return moveScore(a, board) > moveScore(b, board); });
+            return m_continuationHistory[(whitesMove * NUM_MOVES + prevIdx) * NUM_MOVES + idx];
         }
 
     private:
         // One table for each color (0 black 1 white)
         score m_historyTable[2][NUM_MOVES];
+
+        Move m_killers[MAX_SEARCH_DEPTH][NUM_KILLERS];
+
+        // Indexed by [color][moveIdx(prevMove)]
+        Move m_counterMoves[2][NUM_MOVES];
+
+        // Indexed by [color][moveIdx(prevMove)][moveIdx(move)]
+        std::vector<score> m_continuationHistory;
+    };
+
+    /*
+     * Hands out the moves of a position one at a time in the order we want to search them.
+     * The moves are generated in stages and only once a stage is reached, so a node that
+     * cuts off on the transposition table move doesn't generate (or score) any other moves:
+     *  1. The transposition table move
+     *  2. Captures that don't lose material (scored once, then picked best first)
+     *  3. Killer moves and the countermove of the previous move
+     *  4. The remaining quiet moves (picked by history and continuation history score)
+     *  5. Captures that lose material according to the static exchange evaluation
+     *
+     * In captures only mode (quiescent search) stage 3, 4 and 5 are skipped, so losing captures are pruned.
+     */
+    class MovePicker
+    {
+    public:
+        MovePicker(const BoardState &board, Move TTMove, const MoveScorer &scorer, uint8_t ply,
+                   Move prevMove = Move::Null(), bool capturesOnly = false)
+            : m_board(board), m_scorer(scorer), m_TTMove(TTMove), m_prevMove(prevMove), m_ply(ply),
+              m_capturesOnly(capturesOnly)
+        {
+        }
+
+        // Returns the next move to search (or the Null move once all moves have been returned)
+        Move next();
+
+    private:
+        enum class Stage : uint8_t
+        {
+            TTMove,
+            GenerateCaptures,
+            GoodCaptures,
+            GenerateQuiets,
+            Refutations,
+            Quiets,
+            BadCaptures,
+            Done
+        };
+
+        // Scores the moves from m_cur onwards
+        void scoreMoves();
+
+        // Returns the highest scored move from m_cur onwards (and moves it to m_cur)
+        Move pickBest();
+
+        // Wether the move was already returned in an earlier stage
+        bool alreadyPicked(const Move &m) const;
+
+        // The killers and countermove (in the order they are tried)
+        Move refutation(int idx) const;
+
+    private:
+        const BoardState &m_board;
+        const MoveScorer &m_scorer;
+        Move m_TTMove;
+        Move m_prevMove;
+        uint8_t m_ply;
+        bool m_capturesOnly;
+
+        Stage m_stage = Stage::TTMove;
+        bool m_TTMovePicked = false;
+        // the next refutation to try
+        int m_refutationIdx = 0;
+
+        // The losing captures are moved to the front of m_moves when they are picked
+        int m_numBadCaptures = 0;
+        int m_badCaptureIdx = 0;
+
+        // Holds the captures followed by the quiet moves
+        MoveList m_moves;
+        score m_scores[MAX_MOVES];
+        int m_cur = 0;
     };
 
 }
\ No newline at end of file
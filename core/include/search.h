@@ -1,9 +1,12 @@
 #pragma once
 
 #include <functional>
-#include <thread>
+#include <chrono>
 #include <atomic>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <limits>
 
 #include "types.h"
 #include "chess.h"
@@ -16,19 +19,66 @@
 
 namespace chess
 {
-    class Search
+    /*
+     * Evaluation policies for the search.
+     * A policy is called as policy(board, pawnTable) and returns the evaluation from whites perspective.
+     * The pawn hash table belongs to the search (thread) calling it.
+     * Since the policy is a template parameter of the search the evaluation call can be inlined.
+     */
+
+    // The evaluation of the engine (Evaluator::evaluate)
+    struct StaticEvaluation
+    {
+        score operator()(const BoardState &b, PawnHashTable &pawnTable) const { return Evaluator::evaluate(b, pawnTable); }
+    };
+
+    // Type erased evaluation, only meant for tests which use a different evaluation function
+    // (every call goes through the std::function so this is slower than a dedicated policy)
+    struct FunctionEvaluation
+    {
+        std::function<score(const BoardState &)> evalFunction;
+
+        score operator()(const BoardState &b, PawnHashTable &) const { return evalFunction(b); }
+    };
+
+    // The limits of a search (iterativeDeepening), it stops at whichever limit it reaches first
+    struct SearchLimits
+    {
+        TimeLimits time;
+        // The highest depth to complete (the transposition table can't store deeper entries)
+        int depth = TTEntry::MAX_DEPTH;
+        // The nodes the main search may search (0 for no limit)
+        uint64_t nodes = 0;
+        // Only stopped by a stop command (the engine waits for it before reporting the result)
+        bool infinite = false;
+
+        // Not explicit, so a think time or time limits can be passed wherever search limits are expected
+        SearchLimits(Time thinkTime) : time(thinkTime) {}
+        SearchLimits(TimeLimits time) : time(time) {}
+    };
+
+    template <typename EvalPolicy>
+    class BasicSearch
     {
     public:
         struct SearchConfig
         {
-            std::function<score(const BoardState &)> evalFunction;
+            EvalPolicy evaluate;
             RepetitionTable *repTable = nullptr;
             TranspositionTable *transTable = nullptr;
 
+            // Index of the thread running this search. Thread 0 is the main search (which keeps track of the time)
+            // all others are lazy SMP helpers which run until the main search stops them.
+            int threadIdx = 0;
+
+            // The nodes searched by all lazy SMP helpers (shared by the searches of all threads, optional).
+            // The helpers add their nodes to it, so the main search can report the nodes of all threads every iteration.
+            std::atomic<uint64_t> *helperNodes = nullptr;
+
             SearchConfig() = default;
 
-            SearchConfig(std::function<int(const BoardState &)> evalFunc, RepetitionTable *const rt = nullptr)
-                : evalFunction(evalFunc), repTable(rt)
+            SearchConfig(EvalPolicy evalPolicy, RepetitionTable *const rt = nullptr)
+                : evaluate(evalPolicy), repTable(rt)
             {
             }
         };
@@ -39,9 +89,10 @@ namespace chess
         IMPORTANT: the eval function should return ints between [-MATE_EVAL, MATE_EVAL].
         The evaluations that are bellow and above this are used for mate in 0 through mate in MAX_DEPTH.
         */
-        Search(BoardState board, SearchConfig config)
-            : m_rootBoard(board), m_evalFunc(config.evalFunction),
-              m_repTable(config.repTable), m_transTable(config.transTable)
+        BasicSearch(BoardState board, SearchConfig config)
+            : m_rootBoard(board), m_evaluate(config.evaluate),
+              m_repTable(config.repTable), m_transTable(config.transTable),
+              m_threadIdx(config.threadIdx), m_helperNodes(config.helperNodes)
         {
             // If no repetition table is given we use an empty "dummy" table as a placeholder
             if (m_repTable == nullptr)
@@ -53,6 +104,8 @@ namespace chess
 
         void stop() { m_stopped = true; }
 
+        inline bool isMainThread() const { return m_threadIdx == 0; }
+
         // Used for tracking of actual search
         struct SearchStats
         {
@@ -60,29 +113,62 @@ namespace chess
             uint8_t minDepth = 0;
             // Maximum depth including quiescent search
             uint8_t reachedDepth = 0;
-            int searchedNodes = 0;
+            uint64_t searchedNodes = 0;
+            // Beta cut-offs in the main search and how many of those were on the first move
+            // (the ratio shows how good the move ordering is)
+            uint64_t betaCutOffs = 0;
+            uint64_t firstMoveCutOffs = 0;
+            // The number of times the aspiration window had to be widened (and the root searched again)
+            int aspirationFailLows = 0;
+            int aspirationFailHighs = 0;
+            // Lookups in the pawn hash table by the evaluation and how many of those found the pawn structure
+            uint64_t pawnHashProbes = 0;
+            uint64_t pawnHashHits = 0;
+            // The expected line of play, starting with the best move (set at the end of the search)
+            std::vector<Move> principalVariation;
 
             // Overload operator<< for printing
             friend std::ostream &operator<<(std::ostream &os, const SearchStats &info)
             {
                 os << "{ minDepth=" << (int)info.minDepth
                    << ", maxDepth=" << (int)info.reachedDepth
-                   << ", nodesSearched=" << info.searchedNodes << "}";
+                   << ", nodesSearched=" << info.searchedNodes
+                   << ", aspirationReSearches=" << info.aspirationFailLows + info.aspirationFailHighs
+                   << ", pawnHashHitRate=" << 100.0 * info.pawnHashHits / std::max<uint64_t>(1, info.pawnHashProbes) << "%"
+                   << ", pv=";
+                for (size_t i = 0; i < info.principalVariation.size(); i++)
+                    os << (i == 0 ? "" : " ") << info.principalVariation[i].toUCI();
+                os << "}";
                 return os;
             }
         };
 
         SearchStats getStats() const
         {
-            return m_statistics;
+            SearchStats stats = m_statistics;
+            stats.pawnHashProbes = m_pawnTable.probes();
+            stats.pawnHashHits = m_pawnTable.hits();
+            return stats;
         }
 
         // Returns the Move and eval and highest completed depth
-        std::tuple<Move, Eval, SearchStats> iterativeDeepening(Time thinkTime);
+        std::tuple<Move, Eval, SearchStats> iterativeDeepening(SearchLimits limits);
+
+        // Called by the main search after every completed iteration with the stats of that iteration (minDepth and
+        // principalVariation are those of the iteration), its eval and the time spend so far in milliseconds
+        // (searchedNodes includes the nodes the helpers published so far)
+        using IterationCallback = std::function<void(const SearchStats &, Eval, Time)>;
+        void setIterationCallback(IterationCallback onIteration) { m_onIteration = std::move(onIteration); }
 
         // This method is more so used internally, but can also directly be called to search a certain depth.
+        // NOTE: moves are made and unmade on curBoard, after the search it is back in its original state.
+        // ply is the distance from the root (which is no longer minDepth - remainingDepth once depths are reduced)
         template <bool Root>
-        score minimax(const BoardState &curBoard, int remainingDepth, score alpha = SCORE_MIN, score beta = SCORE_MAX);
+        score minimax(BoardState &curBoard, int remainingDepth, score alpha = SCORE_MIN, score beta = SCORE_MAX, uint8_t ply = 0);
+
+        // Limits the extra plies of the quiescent search when calling minimax directly
+        // (iterativeDeepening sets it based on the think time)
+        void setMaxQuiescentDepth(int depth) { m_depths.maxQuiescentDepth = depth; }
 
     private:
         // Used for hard limits on search depth etc.
@@ -98,14 +184,46 @@ namespace chess
 
         DepthSettings initialDepths(Time thinkTime);
 
+        // Searches the root to m_depths.minDepth with a narrow window around the previous iteration's score
+        // (prevScore is from the perspective of the side to move), widening it until the score falls inside.
+        score aspirationSearch(BoardState &board, bool usePrevScore, score prevScore, Move prevBestMove);
+
         // does a search only using captures (MoveGenType::Quiescent)
-        score quiescentSearch(const BoardState &curBoard, int extraDepth, score alpha = SCORE_MIN, score beta = SCORE_MAX);
+        score quiescentSearch(BoardState &curBoard, int extraDepth, uint8_t ply, score alpha = SCORE_MIN, score beta = SCORE_MAX);
+
+        // The depth reduction for a late quiet move (0 if it should be searched at full depth)
+        int lateMoveReduction(Move m, bool whitesMove, int remainingDepth, int moveNumber) const;
+
+        // Null move pruning: if passing the turn (with a reduced depth) still fails high we expect a real move to as well.
+        // Returns true if the node can be pruned (in that case nullEval is set to the score to return)
+        // NOTE: should not be called when in check
+        bool nullMovePrune(BoardState &curBoard, int remainingDepth, score beta, uint8_t ply, score &nullEval);
+
+        // Sets the PV of the node at ply to the move followed by the PV of its child
+        void updatePV(uint8_t ply, Move m);
 
-        // Starts a thread which will set m_stopped to true once the specified time has run out
-        void startTimeThread(Time thinkTime);
+        // Sets the deadline after which checkClock stops the search
+        void startClock(Time thinkTime);
+
+        // Stops the search once the deadline has passed or the node limit is reached. Reading the clock is more
+        // expensive than searching a node, so it is only read every CLOCK_CHECK_INTERVAL nodes (well bellow a millisecond of searching)
+        // (the node limit is checked at the same time, so the search can go up to CLOCK_CHECK_INTERVAL nodes over it)
+        // The helpers have no clock, they publish their nodes to m_helperNodes at the same interval instead.
+        inline void checkClock()
+        {
+            if ((m_statistics.searchedNodes & (CLOCK_CHECK_INTERVAL - 1)) != 0)
+                return;
+
+            if (!isMainThread())
+            {
+                if (m_helperNodes != nullptr)
+                    m_helperNodes->fetch_add(CLOCK_CHECK_INTERVAL, std::memory_order_relaxed);
+                return;
+            }
 
-        // Used to stop the timer early
-        void stopTimeThread();
+            if (std::chrono::steady_clock::now() >= m_deadline || m_statistics.searchedNodes >= m_nodeLimit)
+                m_stopped = true;
+        }
 
         inline bool stopSearch() const
         {
@@ -113,24 +231,55 @@ namespace chess
         }
 
     private:
-        const std::function<score(const BoardState &)> m_evalFunc;
+        const EvalPolicy m_evaluate;
         // Repetition table passed down by the engine class
         RepetitionTable *m_repTable;
         TranspositionTable *m_transTable;
         MoveScorer m_moveScorer;
+        // Caches the pawn structures seen by this search
+        PawnHashTable m_pawnTable;
+
+        // 0 for the main search, > 0 for lazy SMP helpers
+        const int m_threadIdx;
+        // Shared with the other threads (see SearchConfig::helperNodes)
+        std::atomic<uint64_t> *const m_helperNodes;
 
         const BoardState m_rootBoard;
         // current best found move:
         Move m_bestFoundMove;
 
+        // The move made at each ply of the current line (Null for a null move)
+        Move m_movesMade[MAX_SEARCH_DEPTH];
+        // No null moves are tried before this ply (set during a null move verification search)
+        int m_nullMoveMinPly = 0;
+
+        // Triangular PV table, row ply holds the best line found from the node at that ply
+        // (only the first m_pvLength[ply] moves of a row are valid)
+        Move m_pvTable[MAX_SEARCH_DEPTH][MAX_SEARCH_DEPTH];
+        int m_pvLength[MAX_SEARCH_DEPTH];
+        // The PV of the last completed iteration, its moves are searched first in the next iteration
+        std::vector<Move> m_principalVariation;
+        // Set when the node being entered is still on the PV of the previous iteration
+        bool m_followPV = false;
+
         // Handles the limits of the search
         DepthSettings m_depths;
         // tracks the actual search depth etc
         SearchStats m_statistics;
 
         std::atomic<bool> m_stopped = false;
-        std::atomic<bool> m_cancelTimer = false;
-        std::thread m_timerThread;
+
+        // (must be a power of 2)
+        static constexpr int CLOCK_CHECK_INTERVAL = 1024;
+        // Only the main search has a deadline, the helpers are stopped by the main search
+        std::chrono::steady_clock::time_point m_deadline = std::chrono::steady_clock::time_point::max();
+        // The nodes the main search may search (the helpers don't have a node limit)
+        uint64_t m_nodeLimit = std::numeric_limits<uint64_t>::max();
+
+        IterationCallback m_onIteration;
     };
 
+    // The search used by the engine
+    using Search = BasicSearch<StaticEvaluation>;
+
 }
\ No newline at end of file
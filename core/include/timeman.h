@@ -2,17 +2,44 @@
 
 #include <algorithm>
 #include <chrono>
+#include <limits>
+
+#include "chess.h"
+#include "types.h"
 
 namespace chess
 {
     using Time = std::chrono::milliseconds::rep;
 
+    // A think time without a limit, the search only stops when it is stopped (or reaches its depth or node limit)
+    constexpr Time INFINITE_TIME = std::numeric_limits<Time>::max();
+
+    /*
+     * The time the search may spend on a move.
+     * The soft limit is the time we aim to spend, the TimeManager scales it depending on how the search goes
+     * and uses it to decide wether to start another iteration. The search is stopped when the hard limit has passed.
+     */
+    struct TimeLimits
+    {
+        Time soft;
+        Time hard;
+
+        // A fixed think time (not explicit, so a think time can be passed wherever limits are expected)
+        TimeLimits(Time thinkTime) : soft(thinkTime), hard(thinkTime) {}
+        TimeLimits(Time soft, Time hard) : soft(soft), hard(std::max(soft, hard)) {}
+
+        // Wether the think time can be adjusted during the search
+        bool flexible() const { return soft < hard; }
+    };
+
     struct ClockState
     {
         Time btime; // blacks time
         Time wtime; // whites time
         Time binc;
         Time winc;
+        // The moves left until the time control is reset (0 when it is the time for the whole game)
+        int movesToGo = 0;
 
         // No increment
         ClockState(Time wtime, Time btime)
@@ -27,25 +54,105 @@ namespace chess
         }
 
         template <bool whitesMove>
-        Time currentMoveTime(int moveCounter)
+        TimeLimits currentMoveTime(int moveCounter)
         {
             Time ourTime = whitesMove ? wtime : btime;
             Time ourIncrement = whitesMove ? winc : binc;
 
             constexpr int AVG_GAME_LENGTH = 45;
-            // we divide our think time evenly
-            // for each second of increment we are 1 move less conservative in our time slices
-            Time thinkTime = ourTime / (AVG_GAME_LENGTH - moveCounter);
+            // Past the average game length we still expect the game to take this many more moves
+            constexpr int MIN_MOVES_LEFT = 10;
+            // Time kept in reserve for the communication with the gui
+            constexpr Time MOVE_OVERHEAD = 30;
+
+            // (with moves to go we count one extra move, so we don't reach the time control without any time left)
+            int movesLeft = movesToGo > 0 ? movesToGo + 1 : std::max(AVG_GAME_LENGTH - moveCounter, MIN_MOVES_LEFT);
+            Time availableTime = std::max<Time>(ourTime - MOVE_OVERHEAD, 1);
+
+            // we divide our think time evenly over the moves left
+            Time thinkTime = availableTime / movesLeft;
 
             // we always use up our increment:
             thinkTime += ourIncrement;
 
             // when the alotted think time is more than 10% of our remaining time
-            // we cap it to 10% of the remaining time
-            thinkTime = std::min(ourTime / 10, thinkTime);
+            // we cap it to 10% of the remaining time (unless less moves are left till the time control)
+            thinkTime = std::min(availableTime / std::min(movesLeft, 10), thinkTime);
+
+            // Unstable searches may use up to 3 times the think time, but no more than 20% of our time
+            // (unless less than 5 moves are left till the time control)
+            constexpr int MAX_TIME_MULT = 3;
+            Time maxTime = std::min(availableTime / std::min(movesLeft, 5), thinkTime * MAX_TIME_MULT);
+
+            return TimeLimits(thinkTime, maxTime);
+        }
+    };
+
+    /*
+     * Decides when the iterative deepening should stop searching, based on the time limits and
+     * how the search is going. When the best move keeps changing or the score drops between iterations
+     * we spend more time (up to the hard limit), when the best move is stable we stop earlier.
+     */
+    class TimeManager
+    {
+    public:
+        TimeManager(TimeLimits limits)
+            : m_limits(limits), m_startTime(std::chrono::steady_clock::now()), m_softLimit(limits.soft)
+        {
+        }
+
+        // Called after every completed iteration with its best move and score (from the perspective of the side to move)
+        void iterationCompleted(Move bestMove, score eval)
+        {
+            if (!m_limits.flexible())
+                return;
+
+            m_bestMoveStability = bestMove == m_prevBestMove ? m_bestMoveStability + 1 : 0;
+
+            // Scale the think time between 1.6 (best move just changed) and 0.6 (the same best move for 5 iterations)
+            constexpr float STABILITY_SCALE[6] = {1.6, 1.3, 1.1, 0.9, 0.75, 0.6};
+            float scale = STABILITY_SCALE[std::min(m_bestMoveStability, 5)];
+
+            // If the score dropped we might be running into trouble, so we take extra time (up to 1.8x for a drop of 80)
+            constexpr int MAX_SCORE_DROP = 80;
+            if (m_hasPrevEval)
+            {
+                int scoreDrop = std::clamp(m_prevEval - eval, 0, MAX_SCORE_DROP);
+                scale *= 1 + scoreDrop / 100.0;
+            }
+
+            m_softLimit = std::min<Time>(m_limits.soft * scale, m_limits.hard);
+            m_prevBestMove = bestMove;
+            m_prevEval = eval;
+            m_hasPrevEval = true;
+        }
 
-            return thinkTime;
+        // The next iteration usually takes longer than all previous ones together, so we only start it
+        // within half of the soft limit (on average this uses about the soft limit).
+        // With a fixed think time we keep searching until the search is stopped.
+        bool shouldStartIteration() const
+        {
+            return !m_limits.flexible() || elapsed() < m_softLimit / 2;
+        }
+
+        Time hardLimit() const { return m_limits.hard; }
+
+        Time elapsed() const
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_startTime).count();
         }
+
+    private:
+        const TimeLimits m_limits;
+        const std::chrono::steady_clock::time_point m_startTime;
+
+        // The soft limit after the adjustments
+        Time m_softLimit;
+
+        Move m_prevBestMove = Move::Null();
+        int m_bestMoveStability = 0; // The number of iterations the best move didn't change
+        int m_prevEval = 0;
+        bool m_hasPrevEval = false;
     };
 
     inline double timeToSeconds(Time t)
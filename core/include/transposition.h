@@ -3,6 +3,14 @@
 #include <cinttypes>
 #include <iostream>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <type_traits>
+#include <thread>
+
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
 
 #include <string>
 
@@ -18,19 +26,23 @@ namespace chess
      * 1 byte: generation
      * 1 byte: flags (occupied, bound type etc)
      * 4 bytes: move
-     * 4 bytes: hash (only first 32 bits)
-     *
-     * In total this is 2+1+1+4+4 = 12 bytes
-     * (12 bytes with natural allignment)
      *
+     * In total this is 2+1+1+4 = 8 bytes, which allows us to store the entire
+     * entry in a single 64 bit word (see TTSlot).
      */
     struct TTEntry
     {
     public:
-        TTEntry() : flags(0) {}
+        // The depth is stored in 5 bits, so searches can't go deeper than this
+        static constexpr int MAX_DEPTH = 31;
+
+        TTEntry() : eval(0), generation(0), flags(0), move(Move::Null()) {}
         TTEntry(score normalizedEval, uint8_t depth, EvalBound bound, Move bestMove)
-            : flags(depth | 0b100000 | bound), // depth (bits 1-5) occupied (bit 6) bound (bit 78)
-              eval(normalizedEval),
+            : eval(normalizedEval),
+              generation(0),
+              // depth (bits 1-5) occupied (bit 6) bound (bit 78)
+              // (a deeper depth would overwrite the other flags, storing a lower depth is safe)
+              flags(std::min<uint8_t>(depth, MAX_DEPTH) | 0b100000 | bound),
               move(bestMove)
         {
         }
@@ -43,11 +55,6 @@ namespace chess
             return flags & 0b100000;
         }
 
-        inline bool containsHash(key boardHash) const
-        {
-            return occupied() && int32_t(boardHash) == partialHash;
-        }
-
         inline EvalBound bound() const
         {
             // The eval bound options have been chosen to match the 0bxx0
@@ -88,11 +95,11 @@ namespace chess
 
     private:
         // Returns true if the newEntry should replace the current (it is more relevant)
-        bool shouldOverwrite(const TTEntry &newEntry)
+        bool shouldOverwrite(const TTEntry &newEntry) const
         {
-            return !occupied() ||                        // unoccupied
-                   depth() <= newEntry.depth() ||        // better depth
-                   newEntry.generation - generation > 5; // stale current entry
+            return !occupied() ||                                  // unoccupied
+                   depth() <= newEntry.depth() ||                  // better depth
+                   uint8_t(newEntry.generation - generation) > 5; // stale current entry
         }
 
     private:
@@ -108,89 +115,264 @@ namespace chess
          */
         uint8_t flags;
 
-        // we could use int16_t cast of full key (to save more space)
-        // (need additional validation checks to prevent collisions)
-        int32_t partialHash;
-
     public:
-        // Placed here to avoid padding in TTEntry due to natural allignment
         Move move; // the best move found
     };
 
+    /*
+     * The storage of a single TTEntry in the table.
+     *
+     * Multiple search threads read and write the table without any locks. To make sure a
+     * torn entry (half written by two threads) is never used we store the key xored with the data.
+     * When reading we only accept the entry if (keyXorData ^ data) gives back the board hash,
+     * which won't be the case if the two words were written by different threads.
+     * (See Hyatt & Mann, "A lockless transposition table implementation for parallel search")
+     */
+    struct TTSlot
+    {
+    public:
+        TTSlot() : m_keyXorData(0), m_data(0) {}
+
+        // Returns the entry if it belongs to boardHash (otherwise an unoccupied entry)
+        inline TTEntry load(key boardHash) const
+        {
+            uint64_t data = m_data.load(std::memory_order_relaxed);
+            uint64_t keyXorData = m_keyXorData.load(std::memory_order_relaxed);
+
+            if ((keyXorData ^ data) != boardHash)
+                return TTEntry();
+
+            return unpack(data);
+        }
+
+        // Returns the current entry without validating the key (used for replacement decisions)
+        inline TTEntry loadAny() const
+        {
+            return unpack(m_data.load(std::memory_order_relaxed));
+        }
+
+        inline void store(key boardHash, const TTEntry &entry)
+        {
+            uint64_t data = pack(entry);
+            m_keyXorData.store(boardHash ^ data, std::memory_order_relaxed);
+            m_data.store(data, std::memory_order_relaxed);
+        }
+
+        inline void clear()
+        {
+            m_keyXorData.store(0, std::memory_order_relaxed);
+            m_data.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        static_assert(sizeof(TTEntry) == sizeof(uint64_t) && std::is_trivially_copyable_v<TTEntry>,
+                      "A TTEntry has to fit in a single 64 bit word");
+
+        static inline uint64_t pack(const TTEntry &entry) { return std::bit_cast<uint64_t>(entry); }
+
+        static inline TTEntry unpack(uint64_t data) { return std::bit_cast<TTEntry>(data); }
+
+        std::atomic<uint64_t> m_keyXorData;
+        std::atomic<uint64_t> m_data;
+    };
+
+    /*
+     * A cache line sized bucket of slots. Each hash maps to a single bucket which means a probe
+     * only ever touches one cache line, while collisions no longer directly evict (deep) entries.
+     */
+    struct alignas(64) TTBucket
+    {
+        static constexpr int NUM_SLOTS = 4;
+        TTSlot slots[NUM_SLOTS];
+    };
+
     class TranspositionTable
     {
     public:
         // Initialize a transposition table with the specified mbs of storage.
         TranspositionTable(int mbSize)
-            : size((mbSize * 1024 * 1024) / sizeof(TTEntry))
+            : m_curSearchGeneration(0)
         {
-            static_assert(sizeof(TTEntry) == 12);
-            table = new TTEntry[size];
+            static_assert(sizeof(TTEntry) == 8);
+            static_assert(sizeof(TTSlot) == 16);
+            static_assert(sizeof(TTBucket) == 64);
+            allocate(mbSize);
         }
 
         ~TranspositionTable()
         {
-            delete table;
+            free();
         }
 
-        // Note: the TTEntry * might not contain the correct hash
-        TTEntry *get(key boardHash)
+        // The table owns a (possibly huge) allocation so we don't allow copies
+        TranspositionTable(const TranspositionTable &) = delete;
+        TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+        // Reallocates the table with a new size (all entries are lost)
+        // NOTE: should not be called while a search is running
+        void resize(int mbSize)
+        {
+            free();
+            allocate(mbSize);
+        }
+
+        // Returns a copy of the entry stored for this hash
+        // Note: if the table doesn't contain the hash the entry is unoccupied
+        TTEntry get(key boardHash) const
+        {
+            const TTBucket &bucket = table[bucketIdx(boardHash)];
+            for (const TTSlot &slot : bucket.slots)
+            {
+                TTEntry entry = slot.load(boardHash);
+                if (entry.occupied())
+                    return entry;
+            }
+
+            return TTEntry();
+        }
+
+        // Hints the cpu to start loading the bucket of this hash into the cache.
+        // Used to hide the memory latency of the probe in the next node.
+        inline void prefetch(key boardHash) const
         {
-            return &table[boardHash % size];
+#if defined(_MSC_VER)
+            _mm_prefetch(reinterpret_cast<const char *>(&table[bucketIdx(boardHash)]), _MM_HINT_T0);
+#else
+            __builtin_prefetch(&table[bucketIdx(boardHash)]);
+#endif
         }
 
         void set(key boardHash, TTEntry newEntry)
         {
-            TTEntry *entry = &table[boardHash % size];
+            TTBucket &bucket = table[bucketIdx(boardHash)];
+            newEntry.generation = m_curSearchGeneration;
 
-            // Check if we should overwrite our current entry
-            if (!entry->shouldOverwrite(newEntry))
+            // If the position is already in the bucket we only check if we should overwrite that slot
+            for (TTSlot &slot : bucket.slots)
+            {
+                if (!slot.load(boardHash).occupied())
+                    continue;
+
+                if (slot.loadAny().shouldOverwrite(newEntry))
+                    slot.store(boardHash, newEntry);
                 return;
+            }
 
-            // Overwrite
-            *entry = newEntry;
-            entry->generation = m_curSearchGeneration;
-            entry->partialHash = int32_t(boardHash);
+            // Otherwise we replace the least valuable slot (empty, or else shallow and old entries)
+            TTSlot *replace = &bucket.slots[0];
+            int lowestValue = INT32_MAX;
+            for (TTSlot &slot : bucket.slots)
+            {
+                int value = replacementValue(slot.loadAny());
+                if (value < lowestValue)
+                {
+                    lowestValue = value;
+                    replace = &slot;
+                }
+            }
+
+            replace->store(boardHash, newEntry);
         }
 
         // Used to determine if entries are old enough to remove
+        // NOTE: should not be called while a search is running
         void startNewSearch() { m_curSearchGeneration++; }
 
-        void clear()
-        {
-            // Set back to default entries
-            std::fill(table, &table[size], TTEntry());
-        }
+        // Set back to default entries. Large tables take seconds to clear, so they are split over up to maxThreads
+        // threads (small tables are cleared on the calling thread, starting threads would cost more than it saves)
+        void clear(int maxThreads = std::thread::hardware_concurrency());
 
         void purgeStaleEntries(int maxGenerationDiff = 5)
         {
-            for (int i = 0; i < size; i++)
+            for (size_t i = 0; i < size; i++)
             {
-                if (table[i].occupied() && table[i].generation - m_curSearchGeneration > maxGenerationDiff)
-                    table[i] = TTEntry();
+                for (TTSlot &slot : table[i].slots)
+                {
+                    TTEntry entry = slot.loadAny();
+                    if (entry.occupied() && age(entry) > maxGenerationDiff)
+                        slot.clear();
+                }
             }
         }
 
         // Estimates how full the table is
         double fullNess()
         {
-            int searchedEntries = std::min(10000, size);
+            size_t searchedBuckets = std::min(size_t(2500), size);
 
             int fullEntries = 0;
-            for (int i = 0; i < searchedEntries; i++)
+            for (size_t i = 0; i < searchedBuckets; i++)
             {
-                if (table[i].occupied() && table[i].generation - m_curSearchGeneration <= 5)
-                    fullEntries++;
+                for (const TTSlot &slot : table[i].slots)
+                {
+                    TTEntry entry = slot.loadAny();
+                    if (entry.occupied() && age(entry) <= 5)
+                        fullEntries++;
+                }
             }
 
-            return fullEntries / (double)searchedEntries;
+            return fullEntries / (double)(searchedBuckets * TTBucket::NUM_SLOTS);
+        }
+
+        size_t sizeMbs() const { return size * sizeof(TTBucket) / (1024 * 1024); }
+
+        /*
+         * Writes the table (including the search generation) to a binary file so it can be reused later.
+         * The format is a versioned header followed by the raw buckets at a page aligned offset.
+         * Returns false if the file couldn't be written.
+         */
+        bool save(const std::string &path) const;
+
+        /*
+         * Replaces the table with one previously written by save(). The table takes the size of the saved table.
+         * On linux the file is memory mapped (copy on write) so even large tables load almost instantly.
+         * Returns false if the file couldn't be read or is not a valid table (the current table is then kept).
+         */
+        bool load(const std::string &path);
+
+    private:
+        // Allocates a zeroed table (see transposition.cpp), an all zero bucket contains only empty slots
+        void allocate(int mbSize);
+        void free();
+
+        // Maps the hash to [0, size) using a multiply-shift (high 64 bits of hash * size)
+        // which is a lot cheaper than a 64 bit modulo and works for any table size.
+        inline size_t bucketIdx(key boardHash) const
+        {
+#if defined(_MSC_VER)
+            return __umulh(boardHash, size);
+#else
+            return (unsigned __int128)boardHash * size >> 64;
+#endif
+        }
+
+        // How many searches ago the entry was stored
+        inline uint8_t age(const TTEntry &entry) const
+        {
+            return m_curSearchGeneration - entry.generation;
+        }
+
+        // Used to pick which slot in a bucket to replace (lowest value gets replaced)
+        inline int replacementValue(const TTEntry &entry) const
+        {
+            if (!entry.occupied())
+                return INT32_MIN;
+
+            // Each search the entry has been around for is worth 4 plies of depth
+            constexpr int AGE_PENALTY = 4;
+            return entry.depth() - AGE_PENALTY * age(entry);
         }
 
     private:
-        const int size;
-        TTEntry *table;
+        size_t size; // number of buckets
+        TTBucket *table = nullptr;
+
+        // The memory mapping backing the table (nullptr if allocated with new)
+        // Note: for a loaded table the mapping also contains the file header
+        void *m_mapping = nullptr;
+        size_t m_mappingBytes = 0;
 
         // only 8 bits since the TTEntries need to be efficient
         uint8_t m_curSearchGeneration;
     };
-}
\ No newline at end of file
+}
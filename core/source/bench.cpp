@@ -30,23 +30,26 @@ namespace chess
             return std::nullopt;
 
         Search::SearchConfig config;
-        config.evalFunction = Evaluator::evaluate;
         config.repTable = &m_repTable;
         config.transTable = &m_transTable;
 
         Search s(m_currentBoard, config);
+        // the same quiescent depth as the iterative deepening uses on short searches
+        s.setMaxQuiescentDepth(depth + 2);
 
         Timer timer;
-        s.minimax<true>(m_currentBoard, quantity);
-
-        int searchedNodes = s.getStats().searchedNodes;
+        BoardState board = m_currentBoard;
+        s.minimax<true>(board, quantity);
 
         double seconds = timer.elapsedSeconds();
+        Search::SearchStats stats = s.getStats();
 
         BenchResult result;
         result.seconds = seconds;
-        result.searchedNodes = searchedNodes;
+        result.searchedNodes = stats.searchedNodes;
         result.depth = depth;
+        result.betaCutOffs = stats.betaCutOffs;
+        result.firstMoveCutOffs = stats.firstMoveCutOffs;
 
         return result;
     }
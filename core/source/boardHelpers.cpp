@@ -1,9 +1,13 @@
 
 #include <stdexcept>
+#include <algorithm>
 #include "chess.h"
 #include "bitBoard.h"
 #include "moveConstants.h"
 #include "zobristHash.h"
+#include "masks.h"
+#include "eval.h"
+#include "evalTables.h"
 
 #include <iostream>
 
@@ -42,6 +46,106 @@ namespace chess
         return white ? squareAttacked<false>(m_whiteKing) : squareAttacked<true>(m_blackKing);
     }
 
+    bitboard BoardState::attackersTo(square s, bitboard occupancy) const
+    {
+        bitboard diagonalSliders = m_whitePieces[Bishop] | m_whitePieces[Queen] | m_blackPieces[Bishop] | m_blackPieces[Queen];
+        bitboard straightSliders = m_whitePieces[Rook] | m_whitePieces[Queen] | m_blackPieces[Rook] | m_blackPieces[Queen];
+
+        // A white pawn attacks s if it stands where a black pawn on s would attack (and the other way around)
+        bitboard attackers = (mask::pawnAttack<false>(s) & m_whitePieces[Pawn]) |
+                             (mask::pawnAttack<true>(s) & m_blackPieces[Pawn]) |
+                             (constants::knightMoves[s] & (m_whitePieces[Knight] | m_blackPieces[Knight])) |
+                             (constants::kingMoves[s] & (1ULL << m_whiteKing | 1ULL << m_blackKing)) |
+                             (constants::getBishopMoves(s, occupancy) & diagonalSliders) |
+                             (constants::getRookMoves(s, occupancy) & straightSliders);
+
+        return attackers & occupancy;
+    }
+
+    namespace
+    {
+        // The king can only capture as the last piece, so its value never counts
+        constexpr int seeValue(PieceType piece)
+        {
+            return piece == King ? 0 : pieceVals[piece];
+        }
+    }
+
+    int BoardState::staticExchangeEval(const Move &move) const
+    {
+        const bool promotionRank = move.to / 8 == 0 || move.to / 8 == 7;
+
+        bitboard occupancy = allPieces() ^ 1ULL << move.from;
+
+        PieceType captured = m_whitesMove ? pieceOnSquare<false>(move.to) : pieceOnSquare<true>(move.to);
+        if (move.isCapture() && captured == None)
+        {
+            // en passant (the captured pawn isn't on the target square)
+            captured = Pawn;
+            occupancy ^= 1ULL << (m_whitesMove ? move.to - 8 : move.to + 8);
+        }
+
+        // gain[d] is the material won by the side making the d'th capture if the exchange stops after it
+        int gain[32];
+        int depth = 0;
+        gain[0] = captured == None ? 0 : seeValue(captured);
+
+        // the value of the piece that can be captured next (for promotions the new piece)
+        int onSquare = seeValue(move.piece);
+        if (move.isPromotion())
+            gain[0] += pieceVals[move.piece] - pieceVals[Pawn];
+
+        bitboard attackers = attackersTo(move.to, occupancy);
+        bool white = !m_whitesMove;
+        while (true)
+        {
+            bitboard ourAttackers = attackers & allPieces(white);
+            if (!ourAttackers)
+                break;
+
+            // capture with the least valuable attacker
+            const bitboard *pieces = getPieceSet(white);
+            PieceType attacker = King;
+            for (PieceType pt : {Pawn, Knight, Bishop, Rook, Queen})
+            {
+                if (ourAttackers & pieces[pt])
+                {
+                    attacker = pt;
+                    break;
+                }
+            }
+
+            // the king can't capture a defended piece
+            if (attacker == King && (attackers & allPieces(!white)))
+                break;
+
+            depth++;
+            gain[depth] = onSquare - gain[depth - 1];
+            onSquare = seeValue(attacker);
+            if (attacker == Pawn && promotionRank)
+            {
+                gain[depth] += pieceVals[Queen] - pieceVals[Pawn];
+                onSquare = pieceVals[Queen];
+            }
+
+            // remove the attacker, this can reveal sliders behind it (x-rays)
+            bitboard candidates = attacker == King ? ourAttackers : ourAttackers & pieces[attacker];
+            occupancy ^= candidates & -candidates;
+            attackers = attackersTo(move.to, occupancy);
+
+            white = !white;
+        }
+
+        // Going back from the last capture, each side only captures if that is better than stopping
+        while (depth > 0)
+        {
+            gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+            depth--;
+        }
+
+        return gain[0];
+    }
+
     template <PieceType piece, bool white>
     void BoardState::movePiece(square from, square to)
     {
@@ -60,6 +164,15 @@ namespace chess
         constexpr int pieceIdx = piece + (white ? 0 : 6);
         m_hash ^= zobrist::squarePieceKeys[from][pieceIdx];
         m_hash ^= zobrist::squarePieceKeys[to][pieceIdx];
+        if constexpr (piece == PieceType::Pawn)
+            m_evalState.pawnKey ^= zobrist::squarePieceKeys[from][pieceIdx] ^ zobrist::squarePieceKeys[to][pieceIdx];
+
+        // update the piece square table scores (black scores are subtracted)
+        const int8_t *middleGameTable = white ? evalTables::middleGameWhite[piece] : evalTables::middleGameBlack[piece];
+        const int8_t *endGameTable = white ? evalTables::endGameWhite[piece] : evalTables::endGameBlack[piece];
+        constexpr int sign = white ? 1 : -1;
+        m_evalState.middleGameScore += sign * (middleGameTable[to] - middleGameTable[from]);
+        m_evalState.endGameScore += sign * (endGameTable[to] - endGameTable[from]);
     }
 
     template void BoardState::movePiece<PieceType::Pawn, false>(square from, square to);
@@ -84,13 +197,27 @@ namespace chess
             // Should not really be used in general since we can't have multiple instances of the king
             throw std::runtime_error("togglePiece should not be called for the King. Use movePiece instead.");
         }
+        else
+        {
+            bitboard &effectedBitboard = white ? m_whitePieces[piece] : m_blackPieces[piece];
+            effectedBitboard ^= 1ULL << s;
 
-        bitboard &effectedBitboard = white ? m_whitePieces[piece] : m_blackPieces[piece];
-        effectedBitboard ^= 1ULL << s;
+            // update hash
+            constexpr int pieceIdx = piece + (white ? 0 : 6);
+            m_hash ^= zobrist::squarePieceKeys[s][pieceIdx];
+            if constexpr (piece == PieceType::Pawn)
+                m_evalState.pawnKey ^= zobrist::squarePieceKeys[s][pieceIdx];
 
-        // update hash
-        constexpr int pieceIdx = piece + (white ? 0 : 6);
-        m_hash ^= zobrist::squarePieceKeys[s][pieceIdx];
+            // update the evaluation terms (+1 if the piece was added, -1 if it was removed)
+            int change = (effectedBitboard & 1ULL << s) ? 1 : -1;
+            m_evalState.pieceCounts[white][piece] += change;
+            if constexpr (piece != PieceType::Pawn)
+                m_evalState.pieceMaterial[white] += change * pieceVals[piece];
+
+            constexpr int sign = white ? 1 : -1;
+            m_evalState.middleGameScore += sign * change * (white ? evalTables::middleGameWhite : evalTables::middleGameBlack)[piece][s];
+            m_evalState.endGameScore += sign * change * (white ? evalTables::endGameWhite : evalTables::endGameBlack)[piece][s];
+        }
     }
 
     template void BoardState::togglePiece<Pawn, true>(square);
@@ -136,6 +263,44 @@ namespace chess
     template void BoardState::togglePiece<true>(PieceType piece, square s);
     template void BoardState::togglePiece<false>(PieceType piece, square s);
 
+    void BoardState::recomputeEvalState()
+    {
+        m_evalState = EvalState{};
+
+        for (int pieceType = 0; pieceType < 5; pieceType++)
+        {
+            m_evalState.pieceCounts[true][pieceType] = bitBoards::bitCount(m_whitePieces[pieceType]);
+            m_evalState.pieceCounts[false][pieceType] = bitBoards::bitCount(m_blackPieces[pieceType]);
+
+            if (pieceType != Pawn)
+            {
+                m_evalState.pieceMaterial[true] += m_evalState.pieceCounts[true][pieceType] * pieceVals[pieceType];
+                m_evalState.pieceMaterial[false] += m_evalState.pieceCounts[false][pieceType] * pieceVals[pieceType];
+            }
+
+            bitBoards::forEachBit(m_whitePieces[pieceType], [&](square s)
+                                  {
+                m_evalState.middleGameScore += evalTables::middleGameWhite[pieceType][s];
+                m_evalState.endGameScore += evalTables::endGameWhite[pieceType][s]; });
+
+            bitBoards::forEachBit(m_blackPieces[pieceType], [&](square s)
+                                  {
+                m_evalState.middleGameScore -= evalTables::middleGameBlack[pieceType][s];
+                m_evalState.endGameScore -= evalTables::endGameBlack[pieceType][s]; });
+        }
+
+        // Add the king position scores
+        m_evalState.middleGameScore += evalTables::middleGameWhite[King][m_whiteKing];
+        m_evalState.middleGameScore -= evalTables::middleGameBlack[King][m_blackKing];
+        m_evalState.endGameScore += evalTables::endGameWhite[King][m_whiteKing];
+        m_evalState.endGameScore -= evalTables::endGameBlack[King][m_blackKing];
+
+        bitBoards::forEachBit(m_whitePieces[Pawn], [&](square s)
+                              { m_evalState.pawnKey ^= zobrist::getPieceKey(s, Pawn, true); });
+        bitBoards::forEachBit(m_blackPieces[Pawn], [&](square s)
+                              { m_evalState.pawnKey ^= zobrist::getPieceKey(s, Pawn, false); });
+    }
+
     template <bool white>
     PieceType BoardState::pieceOnSquare(square s) const
     {
@@ -2,17 +2,123 @@
 #include "bitBoard.h"
 #include "chess.h"
 #include "moveConstants.h"
+#include "masks.h"
 #include <vector>
 
 namespace chess
 {
 
-    static bitboard s_movingPieces;
-    static bitboard s_opponentPieces;
-    static bitboard s_allPieces;
+    /*
+     * The state of a single pseudoLegalMoves call. It is computed once at the start of the call
+     * and passed to all generators, so move generation doesn't share any state between calls (or threads).
+     */
+    struct MoveGenContext
+    {
+        bitboard movingPieces;
+        bitboard opponentPieces;
+        bitboard allPieces;
+
+        // Only used for the legal move generation:
+        // The squares non king moves need to move to (resolving a check). All squares if not in check.
+        bitboard checkMask;
+        // Our pieces which are pinned to our king (these can only move along the pin)
+        bitboard pinned;
+        // Squares attacked by the opponent (with our king removed so it can't step back along a slider)
+        bitboard kingDanger;
+        square kingSquare;
+    };
 
     using MoveGenType = BoardState::MoveGenType;
 
+    constexpr bool capturesOnly(MoveGenType genT)
+    {
+        return genT == MoveGenType::Quiescent || genT == MoveGenType::LegalQuiescent;
+    }
+
+    constexpr bool quietsOnly(MoveGenType genT)
+    {
+        return genT == MoveGenType::LegalQuiet;
+    }
+
+    constexpr bool legalOnly(MoveGenType genT)
+    {
+        return genT == MoveGenType::Legal || genT == MoveGenType::LegalQuiescent || genT == MoveGenType::LegalQuiet;
+    }
+
+    // The squares the (non king) piece on pos is allowed to move to
+    template <MoveGenType GenT>
+    inline bitboard legalTargets(square pos, const MoveGenContext &ctx)
+    {
+        if constexpr (!legalOnly(GenT))
+            return ~0ULL;
+
+        bitboard targets = ctx.checkMask;
+        if (ctx.pinned & 1ULL << pos)
+            targets &= mask::line(ctx.kingSquare, pos);
+        return targets;
+    }
+
+    // All squares attacked by the given color using the given occupancy for the sliding pieces
+    template <bool ByWhite>
+    bitboard attackedSquares(const BoardState &b, bitboard occupancy)
+    {
+        const bitboard *attacker = b.getPieceSet(ByWhite);
+        bitboard attacks = mask::pawnAttacks<ByWhite>(attacker[PieceType::Pawn]);
+
+        bitBoards::forEachBit(attacker[PieceType::Knight], [&](square s)
+                              { attacks |= constants::knightMoves[s]; });
+        bitBoards::forEachBit(attacker[PieceType::Bishop] | attacker[PieceType::Queen], [&](square s)
+                              { attacks |= constants::getBishopMoves(s, occupancy); });
+        bitBoards::forEachBit(attacker[PieceType::Rook] | attacker[PieceType::Queen], [&](square s)
+                              { attacks |= constants::getRookMoves(s, occupancy); });
+
+        attacks |= constants::kingMoves[ByWhite ? b.getWhiteKingSquare() : b.getBlackKingSquare()];
+        return attacks;
+    }
+
+    // Computes the checkers and pinned pieces once so the generators only emit legal moves
+    template <bool white>
+    void initLegalMasks(const BoardState &b, MoveGenContext &ctx)
+    {
+        const bitboard *opp = b.getPieceSet(!white);
+        square king = white ? b.getWhiteKingSquare() : b.getBlackKingSquare();
+        ctx.kingSquare = king;
+
+        bitboard checkers = (mask::pawnAttack<white>(king) & opp[PieceType::Pawn]) |
+                            (constants::knightMoves[king] & opp[PieceType::Knight]);
+
+        // Sliders that would attack our king on an empty board either check or pin (or are blocked twice)
+        bitboard snipers = (constants::bishopMoves[king] & (opp[PieceType::Bishop] | opp[PieceType::Queen])) |
+                           (constants::rookMoves[king] & (opp[PieceType::Rook] | opp[PieceType::Queen]));
+
+        ctx.pinned = 0;
+        bitBoards::forEachBit(snipers, [&](square sniper)
+                              {
+            bitboard blockers = mask::between(king, sniper) & ctx.allPieces;
+            if (blockers == 0)
+                checkers |= 1ULL << sniper;
+            else if ((blockers & (blockers - 1)) == 0)
+                ctx.pinned |= blockers & ctx.movingPieces; });
+
+        ctx.kingDanger = attackedSquares<!white>(b, ctx.allPieces & ~(1ULL << king));
+
+        if (checkers == 0)
+            ctx.checkMask = ~0ULL;
+        else if ((checkers & (checkers - 1)) == 0) // single check (capture or block the checker)
+            ctx.checkMask = checkers | mask::between(king, bitBoards::firstSetBit(checkers));
+        else // double check (only the king can move)
+            ctx.checkMask = 0;
+    }
+
+    // En passant can expose the king along the rank of both pawns, so we simply try the move
+    // (only happens very rarely)
+    inline bool enpassentIsLegal(const BoardState &b, square from, square to)
+    {
+        BoardState afterMove = b;
+        afterMove.makeMove(Move(from, to, PieceType::Pawn, true));
+        return !afterMove.kingAttacked(b.whitesMove());
+    }
+
     inline void addPromotionMove(square from, square to, bool wasCapture, MoveList &outMoves)
     {
         outMoves.emplace_back(from, to, PieceType::Knight, wasCapture);
@@ -26,29 +132,34 @@ namespace chess
     }
 
     template <MoveGenType GenT>
-    inline void BoardState::addMoves(bitboard moves, square curPos, PieceType piece, MoveList &outMoves) const
+    inline void BoardState::addMoves(bitboard moves, square curPos, PieceType piece, MoveList &outMoves, const MoveGenContext &ctx) const
     {
-        // remove self captures (or for quiescent search only allow captures)
-        GenT == MoveGenType::Normal ? moves &= ~s_movingPieces : moves &= s_opponentPieces;
+        // remove self captures (or for quiescent search only allow captures, or only quiet moves)
+        if constexpr (capturesOnly(GenT))
+            moves &= ctx.opponentPieces;
+        else if constexpr (quietsOnly(GenT))
+            moves &= ~ctx.allPieces;
+        else
+            moves &= ~ctx.movingPieces;
 
         bitBoards::forEachBit(moves, [&](square moveTo)
                               {
-            bool tookPiece = (s_opponentPieces & 1ULL << moveTo);
+            bool tookPiece = (ctx.opponentPieces & 1ULL << moveTo);
             outMoves.emplace_back(curPos, moveTo, piece, tookPiece); });
     }
 
     template <MoveGenType GenT>
-    void BoardState::genKnightMoves(MoveList &outMoves) const
+    void BoardState::genKnightMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         bitboard knights = m_whitesMove ? m_whitePieces[PieceType::Knight] : m_blackPieces[PieceType::Knight];
         bitBoards::forEachBit(knights, [&](square knightPos)
                               {
-            bitboard moves = chess::constants::knightMoves[knightPos];
-            addMoves<GenT>(moves, knightPos, PieceType::Knight, outMoves); });
+            bitboard moves = chess::constants::knightMoves[knightPos] & legalTargets<GenT>(knightPos, ctx);
+            addMoves<GenT>(moves, knightPos, PieceType::Knight, outMoves, ctx); });
     }
 
     template <MoveGenType GenT>
-    void BoardState::genPawnMoves(MoveList &outMoves) const
+    void BoardState::genPawnMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         uint8_t moveDir = m_whitesMove ? 1 : -1;
         bitboard pawns = m_whitesMove ? m_whitePieces[PieceType::Pawn] : m_blackPieces[PieceType::Pawn];
@@ -57,15 +168,19 @@ namespace chess
                               {
             int rank = pawnPos / 8;
             const int ranksMoved = m_whitesMove ? rank - 1 : -rank + 6;
+            // The squares this pawn may move to (everything for pseudo legal generation)
+            const bitboard allowed = legalTargets<GenT>(pawnPos, ctx);
+
             // Skip non capture moves in Quiescent moveGen
-            if (GenT != MoveGenType::Quiescent)
+            if (!capturesOnly(GenT))
             {
                 // gives how many ranks the pawn has moved up/down (0 if not moved and 5 if on the rank before promotion)
 
                 // generate normal step moves
                 square inFront = pawnPos + moveDir * 8;
-                const bitboard blockers = s_allPieces;
+                const bitboard blockers = ctx.allPieces;
                 bool blocked = blockers & 1ULL << inFront;
+                bool stepAllowed = allowed & 1ULL << inFront;
                 if (!blocked)
                 {
                     switch (ranksMoved)
@@ -73,33 +188,50 @@ namespace chess
                     case 0:
                     {
                         // on starting square
-                        outMoves.emplace_back(pawnPos, inFront, PieceType::Pawn, false);
+                        if (stepAllowed)
+                            outMoves.emplace_back(pawnPos, inFront, PieceType::Pawn, false);
                         square twoInFront = pawnPos + moveDir * 16;
-                        if (!(blockers & 1ULL << twoInFront))
+                        if (!(blockers & 1ULL << twoInFront) && (allowed & 1ULL << twoInFront))
                             outMoves.emplace_back(pawnPos, twoInFront, PieceType::Pawn, false);
                         break;
                     }
                     case 5: // Promotions
-                        addPromotionMove(pawnPos, inFront, false, outMoves);
+                        if (stepAllowed)
+                            addPromotionMove(pawnPos, inFront, false, outMoves);
                         break;
                     default: // Normal single forward step
-                        outMoves.emplace_back(pawnPos, inFront, PieceType::Pawn, false);
+                        if (stepAllowed)
+                            outMoves.emplace_back(pawnPos, inFront, PieceType::Pawn, false);
                         break;
                     }
                 }
             }
 
+            if (quietsOnly(GenT))
+                return;
+
             // Pawn capture moves
             int file = pawnPos % 8;
             // m_enpassent square larger than 64 has undefined behaviour.
-            bitboard oppPieces = s_opponentPieces | ((m_enpassentSquare < 64) * 1ULL << m_enpassentSquare);
+            bitboard oppPieces = ctx.opponentPieces | ((m_enpassentSquare < 64) * 1ULL << m_enpassentSquare);
+
+            // Checks if the capture is legal (always true for pseudo legal generation)
+            auto captureAllowed = [&](square takes)
+            {
+                if constexpr (!legalOnly(GenT))
+                    return true;
+
+                if (takes == m_enpassentSquare)
+                    return enpassentIsLegal(*this, pawnPos, takes);
+                return (allowed & 1ULL << takes) != 0;
+            };
 
             if (file != 0)
             {
                 // Check for capture to file-1;
                 square leftTakes = pawnPos + (moveDir * 8) - 1;
                 bool canCapture = oppPieces & 1ULL << leftTakes;
-                if (canCapture)
+                if (canCapture && captureAllowed(leftTakes))
                 {
                     if (ranksMoved == 5)
                         addPromotionMove(pawnPos, leftTakes, true, outMoves);
@@ -113,7 +245,7 @@ namespace chess
                  // Check for capture to file+1;
                  square rightTakes = pawnPos + (moveDir * 8) + 1;
                  bool canCapture = oppPieces & 1ULL << rightTakes;
-                 if (canCapture)
+                 if (canCapture && captureAllowed(rightTakes))
                  {
                      if (ranksMoved == 5)
                          addPromotionMove(pawnPos, rightTakes, true, outMoves);
@@ -124,46 +256,49 @@ namespace chess
     }
 
     template <MoveGenType GenT>
-    void BoardState::genKingMoves(MoveList &outMoves) const
+    void BoardState::genKingMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         square kingPos = m_whitesMove ? m_whiteKing : m_blackKing;
         bitboard moves = constants::kingMoves[kingPos];
-        addMoves<GenT>(moves, kingPos, PieceType::King, outMoves);
+        if constexpr (legalOnly(GenT))
+            moves &= ~ctx.kingDanger;
+        addMoves<GenT>(moves, kingPos, PieceType::King, outMoves, ctx);
     }
 
     template <MoveGenType GenT>
-    void BoardState::genBishopMoves(MoveList &outMoves) const
+    void BoardState::genBishopMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         bitboard bishops = m_whitesMove ? m_whitePieces[PieceType::Bishop] : m_blackPieces[PieceType::Bishop];
         bitBoards::forEachBit(bishops, [&](square bishopPos)
                               {
-            bitboard moves = constants::getBishopMoves(bishopPos, s_allPieces);
-            addMoves<GenT>(moves, bishopPos, PieceType::Bishop, outMoves); });
+            bitboard moves = constants::getBishopMoves(bishopPos, ctx.allPieces) & legalTargets<GenT>(bishopPos, ctx);
+            addMoves<GenT>(moves, bishopPos, PieceType::Bishop, outMoves, ctx); });
     }
 
     template <MoveGenType GenT>
-    void BoardState::genRookMoves(MoveList &outMoves) const
+    void BoardState::genRookMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         bitboard rooks = m_whitesMove ? m_whitePieces[PieceType::Rook] : m_blackPieces[PieceType::Rook];
         bitBoards::forEachBit(rooks, [&](square rookPos)
                               {
-            bitboard moves = constants::getRookMoves(rookPos, s_allPieces);
-            addMoves<GenT>(moves, rookPos, PieceType::Rook, outMoves); });
+            bitboard moves = constants::getRookMoves(rookPos, ctx.allPieces) & legalTargets<GenT>(rookPos, ctx);
+            addMoves<GenT>(moves, rookPos, PieceType::Rook, outMoves, ctx); });
     }
 
     template <MoveGenType GenT>
-    void BoardState::genQueenMoves(MoveList &outMoves) const
+    void BoardState::genQueenMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         bitboard queens = m_whitesMove ? m_whitePieces[PieceType::Queen] : m_blackPieces[PieceType::Queen];
         bitBoards::forEachBit(queens, [&](square queenPos)
                               {
-            bitboard blockers = s_allPieces;
+            bitboard blockers = ctx.allPieces;
             bitboard moves = constants::getRookMoves(queenPos, blockers);
             moves |= constants::getBishopMoves(queenPos, blockers);
-            addMoves<GenT>(moves, queenPos, PieceType::Queen, outMoves); });
+            moves &= legalTargets<GenT>(queenPos, ctx);
+            addMoves<GenT>(moves, queenPos, PieceType::Queen, outMoves, ctx); });
     }
 
-    void BoardState::tryCastle(MoveList &outMoves, bool shortCastle) const
+    void BoardState::tryCastle(MoveList &outMoves, bool shortCastle, const MoveGenContext &ctx) const
     {
         // Check wether the spots between the rook and the king are empty
         bitboard emptySpotMask = shortCastle ? 0b01100000 : 0b00001110;
@@ -176,7 +311,7 @@ namespace chess
             nonAttacked <<= 8 * 7;
         }
 
-        if (s_allPieces & emptySpotMask)
+        if (ctx.allPieces & emptySpotMask)
         {
             // pieces in the way
             return;
@@ -200,77 +335,134 @@ namespace chess
         outMoves.emplace_back(kingPos, newKingPos, PieceType::King, false);
     }
 
-    void BoardState::genCastlingMoves(MoveList &outMoves) const
+    void BoardState::genCastlingMoves(MoveList &outMoves, const MoveGenContext &ctx) const
     {
         if (m_whitesMove)
         {
             if (whiteCanCastleShort())
-                tryCastle(outMoves, true);
+                tryCastle(outMoves, true, ctx);
 
             if (whiteCanCastleLong())
-                tryCastle(outMoves, false);
+                tryCastle(outMoves, false, ctx);
         }
         else
         {
             if (blackCanCastleShort())
-                tryCastle(outMoves, true);
+                tryCastle(outMoves, true, ctx);
 
             if (blackCanCastleLong())
-                tryCastle(outMoves, false);
+                tryCastle(outMoves, false, ctx);
         }
     }
 
+    // Computes the state shared by all generators for a single pseudoLegalMoves call
+    template <MoveGenType GenType>
+    MoveGenContext initContext(const BoardState &b)
+    {
+        MoveGenContext ctx;
+        ctx.movingPieces = b.allPieces(b.whitesMove());
+        ctx.opponentPieces = b.allPieces(!b.whitesMove());
+        ctx.allPieces = ctx.movingPieces | ctx.opponentPieces;
+
+        if constexpr (legalOnly(GenType))
+            b.whitesMove() ? initLegalMasks<true>(b, ctx) : initLegalMasks<false>(b, ctx);
+
+        return ctx;
+    }
+
     template <MoveGenType GenType>
     MoveList BoardState::pseudoLegalMoves() const
     {
         MoveList moves;
+        generateMoves<GenType>(moves);
+        return moves;
+    }
 
-        if (m_whitesMove)
-        {
-            s_movingPieces = whitePieces();
-            s_opponentPieces = blackPieces();
-        }
-        else
+    template <MoveGenType GenType>
+    void BoardState::generateMoves(MoveList &moves) const
+    {
+        MoveGenContext ctx = initContext<GenType>(*this);
+
+        // In double check only the king can move
+        if (legalOnly(GenType) && ctx.checkMask == 0)
         {
-            s_movingPieces = blackPieces();
-            s_opponentPieces = whitePieces();
+            genKingMoves<GenType>(moves, ctx);
+            return;
         }
 
-        s_allPieces = s_movingPieces | s_opponentPieces;
-
-        genPawnMoves<GenType>(moves);
-        genKnightMoves<GenType>(moves);
-        genBishopMoves<GenType>(moves);
-        genRookMoves<GenType>(moves);
-        genQueenMoves<GenType>(moves);
-        genKingMoves<GenType>(moves);
-
-        // Castling can't be a capture
-        if (GenType == MoveGenType::Normal)
-            genCastlingMoves(moves);
-
-        return moves;
+        genPawnMoves<GenType>(moves, ctx);
+        genKnightMoves<GenType>(moves, ctx);
+        genBishopMoves<GenType>(moves, ctx);
+        genRookMoves<GenType>(moves, ctx);
+        genQueenMoves<GenType>(moves, ctx);
+        genKingMoves<GenType>(moves, ctx);
+
+        // Castling can't be a capture (and is never possible out of check)
+        bool inCheck = legalOnly(GenType) && ctx.checkMask != ~0ULL;
+        if (!capturesOnly(GenType) && !inCheck)
+            genCastlingMoves(moves, ctx);
     }
 
-    MoveList BoardState::legalMoves() const
+    bool BoardState::isLegalMove(const Move &move) const
     {
-        MoveList legal;
-        for (auto &m : pseudoLegalMoves<MoveGenType::Normal>())
-        {
-            chess::BoardState bNew = *this;
-            bNew.makeMove(m);
+        MoveGenContext ctx = initContext<MoveGenType::Legal>(*this);
+
+        // Only generate the moves of the piece type that is moved
+        MoveList moves;
+        PieceType movedPiece = move.isPromotion() ? Pawn : move.piece;
+        if (ctx.checkMask == 0 && movedPiece != King)
+            return false; // double check
 
-            // if king is under attack on opponents move thats illegal
-            if (bNew.kingAttacked(!bNew.whitesMove()))
-                continue;
+        switch (movedPiece)
+        {
+        case Pawn:
+            genPawnMoves<MoveGenType::Legal>(moves, ctx);
+            break;
+        case Knight:
+            genKnightMoves<MoveGenType::Legal>(moves, ctx);
+            break;
+        case Bishop:
+            genBishopMoves<MoveGenType::Legal>(moves, ctx);
+            break;
+        case Rook:
+            genRookMoves<MoveGenType::Legal>(moves, ctx);
+            break;
+        case Queen:
+            genQueenMoves<MoveGenType::Legal>(moves, ctx);
+            break;
+        case King:
+            genKingMoves<MoveGenType::Legal>(moves, ctx);
+            if (ctx.checkMask == ~0ULL)
+                genCastlingMoves(moves, ctx);
+            break;
+        default:
+            return false;
+        }
 
-            legal.push_back(m);
+        for (const Move &m : moves)
+        {
+            if (m == move)
+                return true;
         }
 
-        return legal;
+        return false;
+    }
+
+    MoveList BoardState::legalMoves() const
+    {
+        return pseudoLegalMoves<MoveGenType::Legal>();
     }
 
     // Template instantiations
     template MoveList BoardState::pseudoLegalMoves<MoveGenType::Normal>() const;
     template MoveList BoardState::pseudoLegalMoves<MoveGenType::Quiescent>() const;
+    template MoveList BoardState::pseudoLegalMoves<MoveGenType::Legal>() const;
+    template MoveList BoardState::pseudoLegalMoves<MoveGenType::LegalQuiescent>() const;
+    template MoveList BoardState::pseudoLegalMoves<MoveGenType::LegalQuiet>() const;
+
+    template void BoardState::generateMoves<MoveGenType::Normal>(MoveList &moves) const;
+    template void BoardState::generateMoves<MoveGenType::Quiescent>(MoveList &moves) const;
+    template void BoardState::generateMoves<MoveGenType::Legal>(MoveList &moves) const;
+    template void BoardState::generateMoves<MoveGenType::LegalQuiescent>(MoveList &moves) const;
+    template void BoardState::generateMoves<MoveGenType::LegalQuiet>(MoveList &moves) const;
 }
\ No newline at end of file
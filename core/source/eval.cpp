@@ -54,7 +54,7 @@ namespace chess
         int8_t bKingFile = blackKing % 8;
 
         bool whiteToWin = getMaterialBalance() > 0;
-        uint8_t *matingPieceCounts = whiteToWin ? m_whitePieceCounts : m_blackPieceCounts;
+        const uint8_t *matingPieceCounts = whiteToWin ? m_whitePieceCounts : m_blackPieceCounts;
 
         constexpr int centerDistMult = 20;
         constexpr int kingDistMult = 5;
@@ -105,57 +105,90 @@ namespace chess
         return baseBonus + rankBonus * endgameNessMult;
     }
 
+    // The pawnStructureAnalysis score of a single pawn
     template <bool isWhite>
-    score Evaluator::pawnStructureAnalysis()
+    score singlePawnScore(square s, bitboard ourPawns, const FileType *fileTypes, bool isPassedPawn, float endGameNessScore)
     {
-        bitboard ourPawns = isWhite ? m_whiteBitBoards[PieceType::Pawn] : m_blackBitBoards[PieceType::Pawn];
-        bitboard oppPawns = isWhite ? m_blackBitBoards[PieceType::Pawn] : m_whiteBitBoards[PieceType::Pawn];
-
         constexpr score isolationPenalty = 15;
         constexpr score defendedPawnBonus = 5;
         // We want to also multiply the value of the pawn when defended to
         // prioritize defending valuable pawns
         constexpr float defendedPawnMult = 1.1;
 
-        score structureScore = 0;
+        uint8_t file = s % 8;
+        uint8_t rank = s / 8;
+
+        // isolatedPawn analysis
+        bool hasLeftNeighbor = file > 0 && containsPawn<isWhite>(fileTypes[file - 1]);
+        bool hasRightNeighbor = file < 7 && containsPawn<isWhite>(fileTypes[file + 1]);
+        bool isIsolated = !(hasLeftNeighbor || hasRightNeighbor);
 
-        // Lambda to analyze a single pawn
-        auto pawnAnalysis = [&](square s)
+        score pawnScore = 0;
+        if (isIsolated)
+            pawnScore -= isolationPenalty;
+
+        if (isPassedPawn)
+            pawnScore += passedPawnBonus<isWhite>(rank, endGameNessScore);
+
+        // Check if were defended
+        bool isDefended = (mask::pawnAttack<!isWhite>(s) & ourPawns) != 0;
+        if (isDefended)
         {
-            uint8_t file = s % 8;
-            uint8_t rank = s / 8;
+            pawnScore += defendedPawnBonus; // small bonus for being defended
+            // We also multiply to give extra value to defending valuable pawns (passed pawns)
+            pawnScore *= defendedPawnMult;
+        }
 
-            // isolatedPawn analysis
-            bool hasLeftNeighbor = file > 0 && containsPawn<isWhite>(m_fileTypes[file - 1]);
-            bool hasRightNeighbor = file < 7 && containsPawn<isWhite>(m_fileTypes[file + 1]);
-            bool isIsolated = !(hasLeftNeighbor || hasRightNeighbor);
+        return pawnScore;
+    }
 
-            score pawnScore = 0;
-            if (isIsolated)
-                pawnScore -= isolationPenalty;
+    // Finds the passed pawns and scores the other pawns (these don't depend on the endgameness)
+    template <bool isWhite>
+    void analyzePawns(const BoardState &b, PawnStructure &out)
+    {
+        bitboard ourPawns = isWhite ? b.getWhitePawns() : b.getBlackPawns();
+        bitboard oppPawns = isWhite ? b.getBlackPawns() : b.getWhitePawns();
 
-            // passedPawn analysis
-            bitboard mask = mask::passedPawn<isWhite>(s);
-            // check if there are any opponent pawns in the mask
-            bool isPassedPawn = (mask & oppPawns) == 0;
+        out.structureScore[isWhite] = 0;
+        out.passedPawns[isWhite] = 0;
+
+        bitBoards::forEachBit(ourPawns, [&](square s)
+                              {
+            // check if there are any opponent pawns in the passed pawn mask
+            bool isPassedPawn = (mask::passedPawn<isWhite>(s) & oppPawns) == 0;
             if (isPassedPawn)
-                pawnScore += passedPawnBonus<isWhite>(rank, m_endGameNessScore);
-
-            // Check if were defended
-            bool isDefended = (mask::pawnAttack<!isWhite>(s) & ourPawns) != 0;
-            if (isDefended)
-            {
-                pawnScore += defendedPawnBonus; // small bonus for being defended
-                // We also multiply to give extra value to defending valuable pawns (passed pawns)
-                pawnScore *= defendedPawnMult;
-            }
-
-            // Add this pawns score to the total
-            structureScore += pawnScore;
-        };
+                out.passedPawns[isWhite] |= 1ULL << s;
+            else
+                out.structureScore[isWhite] += singlePawnScore<isWhite>(s, ourPawns, out.fileTypes, false, 0); });
+    }
+
+    void analyzePawnStructure(const BoardState &b, PawnStructure &out)
+    {
+        out.pawnKey = b.getPawnKey();
+
+        // Set file types
+        for (int i = 0; i < 8; i++)
+        {
+            out.fileTypes[i] = FileType::CLOSED;
+            if (!(b.getWhitePawns() & mask::fileMask(i)))
+                out.fileTypes[i] |= FileType::HALF_OPEN_WHITE;
+            if (!(b.getBlackPawns() & mask::fileMask(i)))
+                out.fileTypes[i] |= FileType::HALF_OPEN_BLACK;
+        }
+
+        analyzePawns<true>(b, out);
+        analyzePawns<false>(b, out);
+    }
+
+    template <bool isWhite>
+    score Evaluator::pawnStructureAnalysis()
+    {
+        bitboard ourPawns = isWhite ? m_whiteBitBoards[PieceType::Pawn] : m_blackBitBoards[PieceType::Pawn];
 
-        // Do the analysis for each white/black pawn
-        bitBoards::forEachBit(ourPawns, pawnAnalysis);
+        // Only the passed pawns still need to be scored (their bonus depends on the endgameness)
+        score structureScore = m_pawns.structureScore[isWhite];
+        bitBoards::forEachBit(m_pawns.passedPawns[isWhite], [&](square s)
+                              { structureScore += singlePawnScore<isWhite>(s, ourPawns, m_pawns.fileTypes, true, m_endGameNessScore); });
 
         return structureScore;
     }
@@ -164,7 +197,7 @@ namespace chess
     score Evaluator::bishopPairBonus()
     {
         constexpr score bishopPairBonus = 30;
-        uint8_t *ourPieceCounts = isWhite ? m_whitePieceCounts : m_blackPieceCounts;
+        const uint8_t *ourPieceCounts = isWhite ? m_whitePieceCounts : m_blackPieceCounts;
         return ourPieceCounts[PieceType::Bishop] >= 2 ? bishopPairBonus : 0;
     }
 
@@ -213,19 +246,14 @@ namespace chess
         // then we know that the pawn can 100% be promoted
         constexpr score unCatchablePenalty = 300;
 
-        uint8_t *ourPieceCounts = isWhite ? m_whitePieceCounts : m_blackPieceCounts;
+        const uint8_t *ourPieceCounts = isWhite ? m_whitePieceCounts : m_blackPieceCounts;
         // used to determine if we have pieces left to catch the passed pawn if the king can't catch it
         bool weHavePieces = ourPieceCounts[PieceType::Rook] > 0 || ourPieceCounts[PieceType::Queen] > 0 ||
                             ourPieceCounts[PieceType::Knight] > 0 || ourPieceCounts[PieceType::Bishop] > 0;
 
-        bitBoards::forEachBit(enemyPawns,
+        bitBoards::forEachBit(m_pawns.passedPawns[!isWhite],
                               [&](square s)
                               {
-            // Check if the pawn is passed
-            bitboard mask = mask::passedPawn<!isWhite>(s);
-            bool isPassedPawn = (mask & ourPawns) == 0;
-            if (!isPassedPawn)
-                return;
             // check if we are 'in the square' of the passed pawn
             bool inSquare = (kingLocationMask & mask::pawnSquare<!isWhite>(s)) != 0;
             if (inSquare)
@@ -248,9 +276,9 @@ namespace chess
         auto openFileAnalysis = [&](square s)
         {
             uint8_t file = s % 8;
-            if (m_fileTypes[file] == FileType::OPEN)
+            if (m_pawns.fileTypes[file] == FileType::OPEN)
                 bonusses += openFileBonus;
-            else if (m_fileTypes[file] == halfOpen)
+            else if (m_pawns.fileTypes[file] == halfOpen)
                 bonusses += halfOpenFileBonus;
         };
 
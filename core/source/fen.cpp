@@ -137,6 +137,7 @@ namespace chess
 
         // Ensure an up to date hash
         recomputeHash();
+        recomputeEvalState();
     }
 
     char BoardState::charOnSquare(square s) const
@@ -34,5 +34,6 @@ namespace chess
 
         // Ensure an up to date hash
         recomputeHash();
+        recomputeEvalState();
     }
 }
\ No newline at end of file
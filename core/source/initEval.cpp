@@ -17,20 +17,12 @@ namespace chess
      */
     void Evaluator::calculateMaterial()
     {
-        m_whitePieceMaterial = 0;
-        m_blackPieceMaterial = 0;
-
-        for (int pieceType = 1; pieceType < 5; pieceType++)
-        {
-            m_whitePieceCounts[pieceType] = bitBoards::bitCount(m_whiteBitBoards[pieceType]);
-            m_whitePieceMaterial += m_whitePieceCounts[pieceType] * pieceVals[pieceType];
-            m_blackPieceCounts[pieceType] = bitBoards::bitCount(m_blackBitBoards[pieceType]);
-            m_blackPieceMaterial += m_blackPieceCounts[pieceType] * pieceVals[pieceType];
-        }
-
-        // Set the material of the pawns
-        m_whitePieceCounts[PieceType::Pawn] = bitBoards::bitCount(m_whiteBitBoards[PieceType::Pawn]);
-        m_blackPieceCounts[PieceType::Pawn] = bitBoards::bitCount(m_blackBitBoards[PieceType::Pawn]);
+        // The material and piece counts are kept up to date by the board
+        const EvalState &state = m_board.evalState();
+        m_whitePieceCounts = state.pieceCounts[true];
+        m_blackPieceCounts = state.pieceCounts[false];
+        m_whitePieceMaterial = state.pieceMaterial[true];
+        m_blackPieceMaterial = state.pieceMaterial[false];
 
         // Calculate the percentage of (non pawn) pieces that is remaining
         m_piecesMaterialLeft = (m_whitePieceMaterial + m_blackPieceMaterial) / (float)(startingPieceMaterial * 2);
@@ -39,30 +31,9 @@ namespace chess
     // Arguably not initialization, but sets the middleGame and endGame scores
     void Evaluator::calculatePieceSquareTableScores()
     {
-        m_middleGameScore = 0;
-        m_endGameScore = 0;
-
-        // Go through every piece (except king)
-        for (int pieceType = 0; pieceType < 5; pieceType++)
-        {
-            bitBoards::forEachBit(m_whiteBitBoards[pieceType], [&](square s)
-                                  { 
-                m_middleGameScore += evalTables::middleGameWhite[pieceType][s];
-                m_endGameScore += evalTables::endGameWhite[pieceType][s]; });
-
-            bitBoards::forEachBit(m_blackBitBoards[pieceType], [&](square s)
-                                  { 
-                m_middleGameScore -= evalTables::middleGameBlack[pieceType][s];
-                m_endGameScore -= evalTables::endGameBlack[pieceType][s]; });
-        }
-
-        // Add the king position score
-        square whiteKing = m_board.getWhiteKingSquare();
-        square blackKing = m_board.getBlackKingSquare();
-        m_middleGameScore += evalTables::middleGameWhite[PieceType::King][whiteKing];
-        m_middleGameScore -= evalTables::middleGameBlack[PieceType::King][blackKing];
-        m_endGameScore += evalTables::endGameWhite[PieceType::King][whiteKing];
-        m_endGameScore -= evalTables::endGameBlack[PieceType::King][blackKing];
+        // The piece square table scores are kept up to date by the board (when pieces move)
+        m_middleGameScore = m_board.evalState().middleGameScore;
+        m_endGameScore = m_board.evalState().endGameScore;
     }
 
     /*
@@ -92,18 +63,4 @@ namespace chess
         float scoreSquare = score * score;
         m_endGameNessScore = scoreSquare * scoreSquare;
     }
-
-    // Initializes the fileTypes array
-    void Evaluator::determineOpenFiles()
-    {
-        // Set file types
-        for (int i = 0; i < 8; i++)
-        {
-            m_fileTypes[i] = FileType::CLOSED;
-            if (!(m_board.getWhitePawns() & mask::fileMask(i)))
-                m_fileTypes[i] |= FileType::HALF_OPEN_WHITE;
-            if (!(m_board.getBlackPawns() & mask::fileMask(i)))
-                m_fileTypes[i] |= FileType::HALF_OPEN_BLACK;
-        }
-    }
 }
\ No newline at end of file
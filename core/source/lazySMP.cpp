@@ -0,0 +1,135 @@
+#include "engine.h"
+#include <thread>
+#include <vector>
+#include <memory>
+
+namespace chess
+{
+    /*
+     * Lazy SMP: every thread searches the same root position using iterative deepening.
+     * The threads only share the transposition table, so the helpers speed up the main search
+     * by filling the table with entries the main thread can then use.
+     * Each thread has its own move scorer (part of Search) and repetition table.
+     * The helper threads are started by the first search that needs them and wait for the next search in between
+     * (so short searches don't pay for starting and joining the threads on every move).
+     */
+    std::tuple<Move, Eval, Search::SearchStats> Engine::findBestMove(SearchLimits limits, Search::IterationCallback onIteration)
+    {
+        // Signal to the transposition table that we start a new search (generation)
+        // (done once here since all threads share the table)
+        m_transTable.startNewSearch();
+
+        Search::SearchConfig config;
+        config.repTable = &m_repTable;
+        config.transTable = &m_transTable;
+        // (the main search adds them to the nodes it reports after every iteration)
+        m_helperNodes = 0;
+        config.helperNodes = &m_helperNodes;
+
+        int numHelpers = m_threads - 1;
+        if (numHelpers > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_helperMutex);
+            // The number of threads can change between searches, so start the helpers we don't have yet
+            while ((int)m_helperThreads.size() < numHelpers)
+                m_helperThreads.emplace_back(&Engine::helperThreadLoop, this, (int)m_helperThreads.size());
+
+            // The search adds/pops states on the repetition table so each helper needs its own copy
+            m_helperRepTables.assign(numHelpers, m_repTable);
+            m_helperSearches.assign(numHelpers, nullptr);
+            m_helperStats.assign(numHelpers, Search::SearchStats());
+            m_helperLimits = limits;
+            m_activeHelpers = numHelpers;
+            m_runningHelpers = numHelpers;
+            m_helpersStopped = false;
+            m_helperSearchId++;
+        }
+        m_helperCondition.notify_all();
+
+        Search mainSearch(m_currentBoard, config);
+        mainSearch.setIterationCallback(std::move(onIteration));
+        {
+            // Let stopSearch reach the main search (it might have been called before the search was created)
+            std::lock_guard<std::mutex> lock(m_searchMutex);
+            m_mainSearch = &mainSearch;
+            if (m_stopRequested)
+                mainSearch.stop();
+        }
+
+        auto [move, eval, stats] = mainSearch.iterativeDeepening(limits);
+
+        {
+            std::lock_guard<std::mutex> lock(m_searchMutex);
+            m_mainSearch = nullptr;
+        }
+
+        if (numHelpers == 0)
+            return {move, eval, stats};
+
+        // The main search is done so the helpers can stop as well
+        std::unique_lock<std::mutex> lock(m_helperMutex);
+        m_helpersStopped = true;
+        for (Search *helper : m_helperSearches)
+            if (helper != nullptr)
+                helper->stop();
+
+        m_helperCondition.wait(lock, [this]()
+                               { return m_runningHelpers == 0; });
+
+        // report the nodes searched (and pawn hash lookups) by all threads combined
+        for (const Search::SearchStats &helperStats : m_helperStats)
+        {
+            stats.searchedNodes += helperStats.searchedNodes;
+            stats.pawnHashProbes += helperStats.pawnHashProbes;
+            stats.pawnHashHits += helperStats.pawnHashHits;
+        }
+
+        return {move, eval, stats};
+    }
+
+    void Engine::helperThreadLoop(int helperIdx)
+    {
+        uint64_t lastSearchId = 0;
+
+        std::unique_lock<std::mutex> lock(m_helperMutex);
+        while (true)
+        {
+            m_helperCondition.wait(lock, [this, &lastSearchId]()
+                                   { return m_helperSearchId != lastSearchId || m_helperShutdown; });
+
+            if (m_helperShutdown)
+                return;
+
+            lastSearchId = m_helperSearchId;
+            // When fewer threads are configured than before the remaining helpers sit the search out
+            if (helperIdx >= m_activeHelpers)
+                continue;
+
+            Search::SearchConfig config;
+            config.repTable = &m_helperRepTables[helperIdx];
+            config.transTable = &m_transTable;
+            config.threadIdx = helperIdx + 1;
+            config.helperNodes = &m_helperNodes;
+            SearchLimits limits = *m_helperLimits;
+
+            // (the search and its tables are created on this thread, in parallel with the other threads)
+            lock.unlock();
+            auto search = std::make_unique<Search>(m_currentBoard, config);
+            lock.lock();
+
+            // Let the main search reach the helper (it might already be done)
+            m_helperSearches[helperIdx] = search.get();
+            if (m_helpersStopped)
+                search->stop();
+
+            lock.unlock();
+            search->iterativeDeepening(limits);
+            lock.lock();
+
+            m_helperSearches[helperIdx] = nullptr;
+            m_helperStats[helperIdx] = search->getStats();
+            m_runningHelpers--;
+            m_helperCondition.notify_all();
+        }
+    }
+}
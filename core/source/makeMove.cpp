@@ -166,16 +166,18 @@ namespace chess
     }
 
     template <bool whitesMove>
-    void BoardState::makeMove(const Move &move)
+    PieceType BoardState::makeMove(const Move &move)
     {
         // Remove the old enpassent location info
         square prevEnpassentLoc = m_enpassentSquare;
         m_enpassentSquare = -1;
 
+        // (for en passant captures the square is empty so this stays None)
+        PieceType takenPiece = None;
         if (move.isCapture())
         {
             // remove the piece on the square we moved to
-            PieceType takenPiece = pieceOnSquare<!whitesMove>(move.to);
+            takenPiece = pieceOnSquare<!whitesMove>(move.to);
             togglePiece<!whitesMove>(takenPiece, move.to);
         }
 
@@ -210,19 +212,27 @@ namespace chess
         }
 
         updateCastelingRights(move);
+        return takenPiece;
     }
 
-    template void BoardState::makeMove<true>(const Move &move);
-    template void BoardState::makeMove<false>(const Move &move);
+    template PieceType BoardState::makeMove<true>(const Move &move);
+    template PieceType BoardState::makeMove<false>(const Move &move);
 
-    void BoardState::makeMove(const Move &move)
+    UndoInfo BoardState::makeMove(const Move &move)
     {
+        UndoInfo undo;
+        undo.hash = m_hash;
+        undo.enpassentSquare = m_enpassentSquare;
+        undo.castleRights = m_castleRights;
+        undo.pliesSince50MoveRuleReset = m_pliesSince50MoveRuleReset;
+        undo.evalState = m_evalState;
+
         // toggle old enpassent/castling/50 move rule in hash
         m_hash ^= zobrist::getEnpassentKey(m_enpassentSquare);
         m_hash ^= zobrist::castlingKeys[m_castleRights];
         m_hash ^= zobrist::get50MoveRuleKey(m_pliesSince50MoveRuleReset);
 
-        m_whitesMove ? makeMove<true>(move) : makeMove<false>(move);
+        undo.capturedPiece = m_whitesMove ? makeMove<true>(move) : makeMove<false>(move);
 
         move.resets50MoveRule()
             ? m_pliesSince50MoveRuleReset = 0
@@ -240,5 +250,91 @@ namespace chess
         m_hash ^= zobrist::getEnpassentKey(m_enpassentSquare);
         m_hash ^= zobrist::castlingKeys[m_castleRights];
         m_hash ^= zobrist::get50MoveRuleKey(m_pliesSince50MoveRuleReset);
+
+        return undo;
+    }
+
+    void BoardState::unmakeMove(const Move &move, const UndoInfo &undo)
+    {
+        // The side that made the move is the side that is not to move now
+        m_whitesMove = !m_whitesMove;
+
+        // The hash and evaluation terms are restored from the undo info, so we move the pieces back directly
+        // on the bitboards instead of using movePiece/togglePiece (which also update those)
+        bitboard *ourPieces = m_whitesMove ? m_whitePieces : m_blackPieces;
+        bitboard *theirPieces = m_whitesMove ? m_blackPieces : m_whitePieces;
+
+        if (move.isPromotion())
+        {
+            ourPieces[move.piece] ^= 1ULL << move.to;
+            ourPieces[Pawn] ^= 1ULL << move.from;
+        }
+        else if (move.piece == King)
+        {
+            (m_whitesMove ? m_whiteKing : m_blackKing) = move.from;
+
+            if (abs(move.to - move.from) == 2)
+            {
+                // castling, the rook moved to the square the king passed over
+                bool shortCastle = move.to > move.from;
+                square oldRookPos = shortCastle ? move.to + 1 : move.to - 2;
+                square newRookPos = shortCastle ? move.to - 1 : move.to + 1;
+                ourPieces[Rook] ^= 1ULL << oldRookPos | 1ULL << newRookPos;
+            }
+        }
+        else
+        {
+            ourPieces[move.piece] ^= 1ULL << move.from | 1ULL << move.to;
+
+            // put back the pawn taken en passant
+            if (move.piece == Pawn && move.to == undo.enpassentSquare)
+                theirPieces[Pawn] ^= 1ULL << (m_whitesMove ? move.to - 8 : move.to + 8);
+        }
+
+        if (undo.capturedPiece != None)
+            theirPieces[undo.capturedPiece] ^= 1ULL << move.to;
+
+        m_ply -= 1;
+        m_enpassentSquare = undo.enpassentSquare;
+        m_castleRights = undo.castleRights;
+        m_pliesSince50MoveRuleReset = undo.pliesSince50MoveRuleReset;
+        m_hash = undo.hash;
+        m_evalState = undo.evalState;
+    }
+
+    UndoInfo BoardState::makeNullMove()
+    {
+        UndoInfo undo;
+        undo.hash = m_hash;
+        undo.capturedPiece = None;
+        undo.enpassentSquare = m_enpassentSquare;
+        undo.castleRights = m_castleRights;
+        undo.pliesSince50MoveRuleReset = m_pliesSince50MoveRuleReset;
+
+        // toggle old enpassent/50 move rule in hash (castling rights can't change)
+        m_hash ^= zobrist::getEnpassentKey(m_enpassentSquare);
+        m_hash ^= zobrist::get50MoveRuleKey(m_pliesSince50MoveRuleReset);
+
+        // the opponent can't capture en passant after our null move
+        m_enpassentSquare = -1;
+        m_pliesSince50MoveRuleReset += 1;
+        m_ply += 1;
+
+        m_whitesMove = !m_whitesMove;
+        m_hash ^= zobrist::turnKey;
+
+        // toggle new 50 move rule in hash (the enpassent key of no square is 0)
+        m_hash ^= zobrist::get50MoveRuleKey(m_pliesSince50MoveRuleReset);
+
+        return undo;
+    }
+
+    void BoardState::unmakeNullMove(const UndoInfo &undo)
+    {
+        m_whitesMove = !m_whitesMove;
+        m_ply -= 1;
+        m_enpassentSquare = undo.enpassentSquare;
+        m_pliesSince50MoveRuleReset = undo.pliesSince50MoveRuleReset;
+        m_hash = undo.hash;
     }
-}
\ No newline at end of file
+}
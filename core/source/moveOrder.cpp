@@ -5,16 +5,21 @@ namespace chess
 {
     score captureScore(const Move &move, const BoardState &board)
     {
-        score capturingPieceValue = pieceVals[move.piece];
+        // (a legal king capture is always safe so we count the king as worth nothing)
+        score capturingPieceValue = move.piece == King ? 0 : pieceVals[move.piece];
         PieceType capturedPiece = board.whitesMove() ? board.pieceOnSquare<false>(move.to) : board.pieceOnSquare<true>(move.to);
+        // en passant is the only capture where the target square is empty
+        if (capturedPiece == None)
+            capturedPiece = Pawn;
         score differenceInValue = pieceVals[capturedPiece] - capturingPieceValue;
-        // we assume the capture is save (but slightly prefer taking with a lower value piece)
+        // (losing captures are already split off by the static exchange evaluation in the MovePicker)
+        // we slightly prefer taking with a lower value piece
         score moveScore = pieceVals[capturedPiece] + (differenceInValue / 50);
         return moveScore;
     }
     // Is used to order the moves in the move list
     // this increases the performance of the search as we can prune more
-    score MoveScorer::moveScore(Move move, const BoardState &board) const
+    score MoveScorer::moveScore(Move move, const BoardState &board, Move prevMove) const
     {
         // if a quiet move has the maximum value in the history table we still order it before our bad captures
         constexpr score NON_QUIET_OFFSET = TABLE_MAX - 800;
@@ -28,9 +33,147 @@ namespace chess
             return captureScore(move, board) + NON_QUIET_OFFSET;
 
         uint16_t idx = moveIdx(move);
+        bool whitesMove = board.whitesMove();
 
         // This has been tuned a bit by looking at the nodes searched at depth 8 on the starting position
 
-        return m_historyTable[board.whitesMove()][idx];
+        int quietScore = m_historyTable[whitesMove][idx] + continuationEntry(whitesMove, moveIdx(prevMove), idx);
+        return std::min(quietScore, (int)TABLE_MAX);
     }
-}
\ No newline at end of file
+
+    void MovePicker::scoreMoves()
+    {
+        for (int i = m_cur; i < m_moves.size(); i++)
+            m_scores[i] = m_scorer.moveScore(m_moves[i], m_board, m_prevMove);
+    }
+
+    Move MovePicker::pickBest()
+    {
+        // selection instead of sorting, since we often only need the first few moves
+        int best = m_cur;
+        for (int i = m_cur + 1; i < m_moves.size(); i++)
+        {
+            if (m_scores[i] > m_scores[best])
+                best = i;
+        }
+
+        std::swap(m_moves[best], m_moves[m_cur]);
+        std::swap(m_scores[best], m_scores[m_cur]);
+        return m_moves[m_cur++];
+    }
+
+    bool MovePicker::alreadyPicked(const Move &m) const
+    {
+        // refutations are moved in front of m_cur when picked, so only the TT move can come up again
+        return m_TTMovePicked && m == m_TTMove;
+    }
+
+    Move MovePicker::refutation(int idx) const
+    {
+        if (idx < MoveScorer::NUM_KILLERS)
+            return m_scorer.killers(m_ply)[idx];
+
+        return m_scorer.counterMove(m_prevMove, m_board.whitesMove());
+    }
+
+    Move MovePicker::next()
+    {
+        using MoveGenType = BoardState::MoveGenType;
+
+        switch (m_stage)
+        {
+        case Stage::TTMove:
+            m_stage = Stage::GenerateCaptures;
+            // The entry could belong to a different position with the same hash so we check the move is legal
+            if (!m_TTMove.isNull() && (!m_capturesOnly || m_TTMove.isCapture()) && m_board.isLegalMove(m_TTMove) &&
+                (!m_capturesOnly || m_board.staticExchangeEval(m_TTMove) >= 0))
+            {
+                m_TTMovePicked = true;
+                return m_TTMove;
+            }
+            [[fallthrough]];
+
+        case Stage::GenerateCaptures:
+            m_board.generateMoves<MoveGenType::LegalQuiescent>(m_moves);
+            scoreMoves();
+            m_stage = Stage::GoodCaptures;
+            [[fallthrough]];
+
+        case Stage::GoodCaptures:
+            while (m_cur < m_moves.size())
+            {
+                Move m = pickBest();
+                if (alreadyPicked(m))
+                    continue;
+
+                // Losing captures are delayed till after the quiet moves
+                if (m_board.staticExchangeEval(m) < 0)
+                {
+                    std::swap(m_moves[m_numBadCaptures++], m_moves[m_cur - 1]);
+                    continue;
+                }
+
+                return m;
+            }
+
+            if (m_capturesOnly)
+            {
+                m_stage = Stage::Done;
+                return Move::Null();
+            }
+            m_stage = Stage::GenerateQuiets;
+            [[fallthrough]];
+
+        case Stage::GenerateQuiets:
+            // (added after the captures, m_cur already points past them)
+            m_board.generateMoves<MoveGenType::LegalQuiet>(m_moves);
+            m_stage = Stage::Refutations;
+            [[fallthrough]];
+
+        case Stage::Refutations:
+            // The refutations come from other positions, so we only use them if they are in the generated quiets
+            // (a countermove that is also a killer was already moved in front of m_cur, so it isn't found twice)
+            while (m_refutationIdx < MoveScorer::NUM_KILLERS + 1)
+            {
+                Move refutationMove = refutation(m_refutationIdx++);
+                if (refutationMove.isNull() || alreadyPicked(refutationMove))
+                    continue;
+
+                for (int i = m_cur; i < m_moves.size(); i++)
+                {
+                    if (m_moves[i] == refutationMove)
+                    {
+                        std::swap(m_moves[i], m_moves[m_cur]);
+                        return m_moves[m_cur++];
+                    }
+                }
+            }
+
+            scoreMoves();
+            m_stage = Stage::Quiets;
+            [[fallthrough]];
+
+        case Stage::Quiets:
+            while (m_cur < m_moves.size())
+            {
+                Move m = pickBest();
+                if (!alreadyPicked(m))
+                    return m;
+            }
+
+            m_stage = Stage::BadCaptures;
+            [[fallthrough]];
+
+        case Stage::BadCaptures:
+            if (m_badCaptureIdx < m_numBadCaptures)
+                return m_moves[m_badCaptureIdx++];
+
+            m_stage = Stage::Done;
+            [[fallthrough]];
+
+        case Stage::Done:
+        default:
+            return Move::Null();
+        }
+    }
+}
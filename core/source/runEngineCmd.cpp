@@ -1,115 +1,222 @@
 #include "engine.h"
 #include <iostream>
-#include <regex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
 
 #include "boardVisualizer.h"
 
+// (the replies that can be printed while searching are written at once, so they don't end up inside the search output)
 void cmdInvallid(std::string cmd)
 {
-    std::cout << "'" << cmd << "' is not a valid command" << std::endl;
+    std::cout << "'" + cmd + "' is not a valid command\n" << std::flush;
 }
 
-namespace chess
+// The remaining arguments of a command (for arguments that can contain spaces, like a fen or path)
+static std::string restOfLine(std::istringstream &args)
 {
+    std::string rest;
+    std::getline(args >> std::ws, rest);
+    return rest;
+}
 
+namespace chess
+{
+    /*
+     * The commands are dispatched on their first word through a table that is build once (on the first command).
+     * Each handler parses its own arguments and returns false when they are invalid.
+     * The UCI commands forward to uci.cpp.
+     */
     void Engine::runCmd(std::string cmd)
     {
-        std::regex setPosRegex("setPosition ([\\w/0-9\\-\\s]+)");
-        std::regex bestMoveRegex("bestMove (\\d+(\\.\\d+)?)");
-        std::regex makeMoveRegex("makeMove (\\w+)");
-        std::regex benchmarkRegex("bench (\\w+) (\\d+(\\.\\d+)?)");
-        std::regex goRegex("go wtime (\\d+) btime (\\d+)( winc (\\d+) binc (\\d+))?");
-        std::smatch match;
-
-        if (std::regex_match(cmd, match, setPosRegex))
-        {
-            std::string fen = match[1];
-            setPosition(BoardState(fen));
+        using CommandHandler = bool (*)(Engine &engine, std::istringstream &args);
 
-            std::cout << "done" << std::endl;
-        }
-        else if (cmd.starts_with("getPosition"))
-            std::cout << m_currentBoard.fen() << std::endl;
-        else if (std::regex_match(cmd, match, makeMoveRegex))
-        {
-            bool succes = makeMove(match[1]);
-            if (succes)
-                std::cout << "done" << std::endl;
-            else
-                std::cout << "'" << match[1] << "' is not a legal move!" << std::endl;
-        }
-        else if (std::regex_match(cmd, match, goRegex))
+        constexpr CommandHandler showBoard = [](Engine &engine, std::istringstream &)
         {
-            Time wtime = std::stol(match[1]);
-            Time btime = std::stol(match[2]);
-            Time winc = 0;
-            Time binc = 0;
-
-            if (match[3].matched)
-            {
-                winc = std::stol(match[4]);
-                binc = std::stol(match[5]);
-            }
-
-            ClockState clock(wtime, btime, winc, binc);
-            int moveCounter = m_currentBoard.ply() / 2;
-            Time thinkTime = m_currentBoard.whitesMove()
-                                 ? clock.currentMoveTime<true>(moveCounter)
-                                 : clock.currentMoveTime<false>(moveCounter);
-
-            auto [move, eval, info] = findBestMove(thinkTime);
-            double ttFullness = m_transTable.fullNess();
-            std::cout << "info (eval: " << eval << ", searchinfo: " << info
-                      << ", ttFullness: " << ttFullness
-                      << ", spend time: " << (thinkTime / 1000) << ")" << std::endl;
-            std::cout << "bestmove " << move.toUCI() << std::endl;
-        }
-        else if (std::regex_match(cmd, match, bestMoveRegex))
-        {
-            double seconds = std::stod(match[1]);
-            if (m_currentBoard.drawBy50MoveRule())
-            {
-                std::cout << "Draw by 50 move rule" << std::endl;
-                return;
-            }
-
-            auto [move, eval, info] = findBestMove(seconds * 1000);
-            double ttFullness = m_transTable.fullNess();
-            std::cout << move.toUCI() << " (eval: " << eval << ", searchinfo: " << info
-                      << ", ttFullness: " << ttFullness << ")" << std::endl;
-        }
-        else if (std::regex_match(cmd, match, benchmarkRegex))
-        {
-            std::string benchType = match[1];
-            double quantity = std::stod(match[2]);
-            if (benchType == "depth")
-            {
-                std::optional<BenchResult> result = bench<BenchType::Depth>(quantity);
-                if (!result)
-                {
-                    std::cout << "Invalid benchmark configuration" << std::endl;
-                    return;
-                }
-
-                BenchResult res = *result;
-                std::cout << "Bench result: " << res.searchedNodes << " nodes in " << res.seconds
-                          << " seconds (depth: " << res.depth << ")" << std::endl;
-                return;
-            }
-
-            std::cout << "Invalid benchmark type: " << benchType << std::endl;
-        }
-        else if (cmd == "showBoard" || cmd == "show")
-        {
-            std::cout << m_currentBoard.fen() << std::endl;
-            showBoardGUI(m_currentBoard);
-        }
-        else if (cmd == "quit" || cmd == "exit")
+            std::cout << engine.m_currentBoard.fen() << std::endl;
+            showBoardGUI(engine.m_currentBoard);
+            return true;
+        };
+
+        constexpr CommandHandler quit = [](Engine &engine, std::istringstream &)
         {
-            m_quit = true;
+            engine.stopSearch();
+            engine.waitForSearch();
+            engine.m_quit = true;
             std::cout << "done" << std::endl;
-        }
-        else
+            return true;
+        };
+
+        static const std::unordered_map<std::string_view, CommandHandler> commands = {
+            {"setPosition", [](Engine &engine, std::istringstream &args)
+             {
+                 std::string fen = restOfLine(args);
+                 if (fen.empty())
+                     return false;
+
+                 engine.setPosition(BoardState(fen));
+                 std::cout << "done" << std::endl;
+                 return true;
+             }},
+            {"getPosition", [](Engine &engine, std::istringstream &)
+             {
+                 std::cout << engine.m_currentBoard.fen() << std::endl;
+                 return true;
+             }},
+            {"makeMove", [](Engine &engine, std::istringstream &args)
+             {
+                 std::string move;
+                 if (!(args >> move))
+                     return false;
+
+                 if (engine.makeMove(move))
+                     std::cout << "done" << std::endl;
+                 else
+                     std::cout << "'" << move << "' is not a legal move!" << std::endl;
+                 return true;
+             }},
+            {"bestMove", [](Engine &engine, std::istringstream &args)
+             {
+                 double seconds;
+                 if (!(args >> seconds))
+                     return false;
+
+                 if (engine.m_currentBoard.drawBy50MoveRule())
+                 {
+                     std::cout << "Draw by 50 move rule" << std::endl;
+                     return true;
+                 }
+
+                 engine.startSearch(seconds * 1000, [&engine](Move move, Eval eval, const Search::SearchStats &info)
+                                    {
+                     double ttFullness = engine.m_transTable.fullNess();
+
+                     std::ostringstream out;
+                     out << move.toUCI() << " (eval: " << eval << ", searchinfo: " << info
+                         << ", ttFullness: " << ttFullness << ")\n";
+                     std::cout << out.str() << std::flush; });
+                 return true;
+             }},
+            {"go", [](Engine &engine, std::istringstream &args)
+             {
+                 engine.goCmd(args);
+                 return true;
+             }},
+            {"stop", [](Engine &engine, std::istringstream &)
+             {
+                 // The result of the stopped search is still printed (by the search thread)
+                 engine.stopSearch();
+                 return true;
+             }},
+            {"isready", [](Engine &, std::istringstream &)
+             {
+                 // Answered right away, also while searching
+                 std::cout << "readyok\n" << std::flush;
+                 return true;
+             }},
+            {"bench", [](Engine &engine, std::istringstream &args)
+             {
+                 std::string benchType;
+                 double quantity;
+                 if (!(args >> benchType >> quantity))
+                     return false;
+
+                 engine.finishSearch();
+                 if (benchType == "depth")
+                 {
+                     std::optional<BenchResult> result = engine.bench<BenchType::Depth>(quantity);
+                     if (!result)
+                     {
+                         std::cout << "Invalid benchmark configuration" << std::endl;
+                         return true;
+                     }
+
+                     BenchResult res = *result;
+                     std::cout << "Bench result: " << res.searchedNodes << " nodes in " << res.seconds
+                               << " seconds (depth: " << res.depth << ")" << std::endl;
+                     return true;
+                 }
+
+                 std::cout << "Invalid benchmark type: " << benchType << std::endl;
+                 return true;
+             }},
+            {"setTTMbs", [](Engine &engine, std::istringstream &args)
+             {
+                 int mbSize;
+                 if (!(args >> mbSize))
+                     return false;
+
+                 if (mbSize < 1)
+                 {
+                     std::cout << "The transposition table needs at least 1 mb" << std::endl;
+                     return true;
+                 }
+
+                 engine.setTranspositionTableSize(mbSize);
+                 std::cout << "done" << std::endl;
+                 return true;
+             }},
+            {"saveTT", [](Engine &engine, std::istringstream &args)
+             {
+                 std::string path = restOfLine(args);
+                 if (path.empty())
+                     return false;
+
+                 engine.finishSearch();
+                 if (engine.m_transTable.save(path))
+                     std::cout << "done" << std::endl;
+                 else
+                     std::cout << "Could not save the transposition table to '" << path << "'" << std::endl;
+                 return true;
+             }},
+            {"loadTT", [](Engine &engine, std::istringstream &args)
+             {
+                 std::string path = restOfLine(args);
+                 if (path.empty())
+                     return false;
+
+                 engine.finishSearch();
+                 if (engine.m_transTable.load(path))
+                     std::cout << "done" << std::endl;
+                 else
+                     std::cout << "Could not load a transposition table from '" << path << "'" << std::endl;
+                 return true;
+             }},
+            {"showBoard", showBoard},
+            {"show", showBoard},
+            {"quit", quit},
+            {"exit", quit},
+            // UCI (see uci.cpp)
+            {"uci", [](Engine &engine, std::istringstream &)
+             {
+                 engine.uciCmd();
+                 return true;
+             }},
+            {"ucinewgame", [](Engine &engine, std::istringstream &)
+             {
+                 engine.finishSearch();
+                 engine.m_transTable.clear();
+                 engine.m_repTable.clear();
+                 return true;
+             }},
+            {"position", [](Engine &engine, std::istringstream &args)
+             {
+                 engine.positionCmd(args);
+                 return true;
+             }},
+            {"setoption", [](Engine &engine, std::istringstream &args)
+             {
+                 engine.setOptionCmd(args);
+                 return true;
+             }},
+        };
+
+        std::istringstream args(cmd);
+        std::string name;
+        args >> name;
+
+        auto command = commands.find(name);
+        if (command == commands.end() || !command->second(*this, args))
             cmdInvallid(cmd);
     }
-}
\ No newline at end of file
+}
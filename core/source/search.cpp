@@ -2,7 +2,6 @@
 #include <algorithm>
 #include <functional>
 #include <chrono>
-#include <thread>
 #include <cmath>
 
 #include "chess.h"
@@ -12,38 +11,18 @@ namespace chess
 {
     using MoveGenType = BoardState::MoveGenType;
 
-    void Search::startTimeThread(Time thinkTime)
+    template <typename EvalPolicy>
+    void BasicSearch<EvalPolicy>::startClock(Time thinkTime)
     {
-        m_stopped = false; // Reset before starting
-        m_cancelTimer = false;
-
-        // Launch a detached thread to stop search after thinkSeconds
-        m_timerThread = std::thread([this, thinkTime]()
-                                    {
-                                        auto endTime = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(thinkTime);
-
-                                        while (std::chrono::steady_clock::now() < endTime)
-                                        {
-                                            if (m_cancelTimer)
-                                            {
-                                                // If cancelled, exit early
-                                                m_stopped = true;
-                                                return;
-                                            }
-
-                                            std::this_thread::sleep_for(std::chrono::milliseconds(100)); // Sleep for a short time to check cancellation
-                                        }
-                                        m_stopped = true; // Time expired, mark as stopped
-                                    });
-    }
-
-    void Search::stopTimeThread()
-    {
-        m_cancelTimer = true;
-        m_timerThread.join();
+        // NOTE: m_stopped is not reset, the search might already have been stopped before it started
+        if (thinkTime == INFINITE_TIME)
+            m_deadline = std::chrono::steady_clock::time_point::max();
+        else
+            m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(thinkTime);
     }
 
-    Search::DepthSettings Search::initialDepths(Time thinkTime)
+    template <typename EvalPolicy>
+    typename BasicSearch<EvalPolicy>::DepthSettings BasicSearch<EvalPolicy>::initialDepths(Time thinkTime)
     {
         constexpr int MAX_INITIAL_DEPTH = 4;
         float sqrtTime = std::sqrt(timeToSeconds(thinkTime));
@@ -57,40 +36,54 @@ namespace chess
         return DepthSettings(minDepth, maxQuiescentDepth);
     }
 
-    std::tuple<Move, Eval, Search::SearchStats>
-    Search::iterativeDeepening(Time thinkTime)
+    template <typename EvalPolicy>
+    std::tuple<Move, Eval, typename BasicSearch<EvalPolicy>::SearchStats>
+    BasicSearch<EvalPolicy>::iterativeDeepening(SearchLimits limits)
     {
-        startTimeThread(thinkTime);
-
-        // Signal to the transposition table that we start a new search (generation)
-        m_transTable->startNewSearch();
+        // Only the main thread keeps track of the time (and nodes), the helpers are stopped by the main thread.
+        // NOTE: the caller is responsible for calling startNewSearch on the transposition table
+        // (it is shared between all threads)
+        TimeManager timeManager(limits.time);
+        if (isMainThread())
+        {
+            startClock(timeManager.hardLimit());
+            if (limits.nodes > 0)
+                m_nodeLimit = limits.nodes;
+        }
 
         // reset bestFoundMove
         m_bestFoundMove = Move::Null();
+        m_principalVariation.clear();
+        m_pvLength[0] = 0;
 
-        int evalScore;
+        int evalScore = 0;
         Eval eval = evalFromScore(0, 0);
 
         int newScore;
 
-        Search::DepthSettings prevDepths;
-        Search::SearchStats prevStats;
+        // The best move of the last completed iteration (in case the current one fails low and is stopped)
+        Move lastBestMove = Move::Null();
+        bool completedIteration = false;
 
-        m_depths = initialDepths(thinkTime);
+        m_depths = initialDepths(limits.time.soft);
+        // (the initial depth is never searched, so it has to stay bellow the depth limit)
+        m_depths.minDepth = std::min(m_depths.minDepth, std::max(limits.depth - 1, 0));
 
-        const bool root = true;
+        // Lazy SMP: let half of the helpers search one ply deeper so the threads
+        // diverge and fill the shared transposition table with different entries
+        if (!isMainThread())
+            m_depths.minDepth += m_threadIdx % 2;
 
-        while (eval.type != Eval::Type::MATE || std::abs(eval.movesTillMate()) >= (m_depths.minDepth + 1) / 2)
+        while ((eval.type != Eval::Type::MATE || std::abs(eval.movesTillMate()) >= (m_depths.minDepth + 1) / 2) &&
+               m_depths.minDepth < limits.depth)
         {
-            // Update the info to the collected info from previous completed search
-            prevDepths = m_depths;
-            prevStats = m_statistics;
-
             m_depths.minDepth += 1;
             m_depths.maxQuiescentDepth += 1;
 
             int8_t sideToMove = m_rootBoard.whitesMove() ? 1 : -1;
-            newScore = minimax<root>(m_rootBoard, m_depths.minDepth) * sideToMove;
+            // the search makes and unmakes moves on this board
+            BoardState board = m_rootBoard;
+            newScore = aspirationSearch(board, completedIteration, evalScore * sideToMove, lastBestMove) * sideToMove;
 
             // if search is stopped early return using the previous depth results
             // If we are stopped and the minDepth is greater than MAX_SEARCH_DEPTH we are probably
@@ -106,22 +99,115 @@ namespace chess
             // only update with each completed search
             evalScore = newScore;
             eval = evalFromScore(evalScore, m_depths.minDepth);
+            lastBestMove = m_bestFoundMove;
+            completedIteration = true;
+            m_principalVariation.assign(m_pvTable[0], m_pvTable[0] + m_pvLength[0]);
+
+            if (m_onIteration)
+            {
+                SearchStats iterationStats = getStats();
+                iterationStats.minDepth = m_depths.minDepth;
+                iterationStats.principalVariation = m_principalVariation;
+                if (m_helperNodes != nullptr)
+                    iterationStats.searchedNodes += m_helperNodes->load(std::memory_order_relaxed);
+                m_onIteration(iterationStats, eval, timeManager.elapsed());
+            }
+
+            // Don't start an iteration we (most likely) can't complete
+            timeManager.iterationCompleted(m_bestFoundMove, evalScore * sideToMove);
+            if (isMainThread() && !timeManager.shouldStartIteration())
+                break;
+        }
+
+        // When the search was stopped before any move was searched we still need to return a (legal) move
+        if (m_bestFoundMove.isNull())
+        {
+            MoveList moves = m_rootBoard.legalMoves();
+            if (moves.size() > 0)
+                m_bestFoundMove = moves[0];
         }
 
-        // The search is done so we stop any still going timer
-        stopTimeThread();
+        // When the last iteration was stopped after finding a different best move, its (partial) PV belongs to that move
+        if (m_pvLength[0] > 0 && m_pvTable[0][0] == m_bestFoundMove)
+            m_principalVariation.assign(m_pvTable[0], m_pvTable[0] + m_pvLength[0]);
+        if (m_principalVariation.empty() || m_principalVariation[0] != m_bestFoundMove)
+            m_principalVariation = {m_bestFoundMove};
+        m_statistics.principalVariation = m_principalVariation;
 
-        // Set the actually used minDepth
-        m_statistics.minDepth = prevDepths.minDepth;
+        // Set the actually used minDepth (m_depths is always that of the last completed iteration here)
+        m_statistics.minDepth = m_depths.minDepth;
 
-        return {m_bestFoundMove, eval, m_statistics};
+        return {m_bestFoundMove, eval, getStats()};
+    }
+
+    template <typename EvalPolicy>
+    score BasicSearch<EvalPolicy>::aspirationSearch(BoardState &board, bool usePrevScore, score prevScore, Move prevBestMove)
+    {
+        // The window is this far around the previous score and doubles each time it fails
+        constexpr int ASPIRATION_WINDOW = 25;
+        // Once the window would get wider than this we stop guessing (the score is probably going to a mate score)
+        constexpr int ASPIRATION_MAX_WINDOW = 400;
+        const bool root = true;
+
+        // Without a previous score (or when it is a mate score) we can't guess where the score will be
+        if (!usePrevScore || std::abs(prevScore) >= MIN_MATE_SCORE)
+            return minimax<root>(board, m_depths.minDepth);
+
+        int delta = ASPIRATION_WINDOW;
+        int alpha = prevScore - delta;
+        int beta = prevScore + delta;
+        bool failedLow = false;
+
+        while (true)
+        {
+            score result = minimax<root>(board, m_depths.minDepth, std::max(alpha, SCORE_MIN), std::min(beta, SCORE_MAX));
+
+            if (stopSearch())
+            {
+                // After failing low the moves found by the (unfinished) re-search are not trustworthy,
+                // so we fall back to the best move of the previous iteration
+                if (failedLow)
+                    m_bestFoundMove = prevBestMove;
+                return result;
+            }
+
+            // The search returns a score outside the window only if the true score is outside it as well
+            // (in that case the score is only a bound so we need to search again with a wider window)
+            if (result < alpha && alpha > SCORE_MIN)
+            {
+                m_statistics.aspirationFailLows++;
+                alpha = delta >= ASPIRATION_MAX_WINDOW ? SCORE_MIN : alpha - delta;
+                failedLow = true;
+            }
+            else if (result > beta && beta < SCORE_MAX)
+            {
+                m_statistics.aspirationFailHighs++;
+                beta = delta >= ASPIRATION_MAX_WINDOW ? SCORE_MAX : beta + delta;
+            }
+            else
+            {
+                return result;
+            }
+
+            delta *= 2;
+        }
+    }
+
+    template <typename EvalPolicy>
+    void BasicSearch<EvalPolicy>::updatePV(uint8_t ply, Move m)
+    {
+        int childLength = ply + 1 < MAX_SEARCH_DEPTH ? m_pvLength[ply + 1] : 0;
+
+        m_pvTable[ply][0] = m;
+        std::copy(m_pvTable[ply + 1], m_pvTable[ply + 1] + childLength, m_pvTable[ply] + 1);
+        m_pvLength[ply] = childLength + 1;
     }
 
     // Uses RAII to pop and add a board to the repetition table
     class RepetitionScope
     {
     public:
-        RepetitionScope(RepetitionTable *repTable, BoardState b)
+        RepetitionScope(RepetitionTable *repTable, const BoardState &b)
             : m_repTable(repTable)
         {
             m_repTable->addState(b);
@@ -136,8 +222,9 @@ namespace chess
         RepetitionTable *m_repTable;
     };
 
+    template <typename EvalPolicy>
     template <bool Root>
-    score Search::minimax(const BoardState &curBoard, int remainingDepth, score alpha, score beta)
+    score BasicSearch<EvalPolicy>::minimax(BoardState &curBoard, int remainingDepth, score alpha, score beta, uint8_t ply)
     {
         // cancel the search
         if (stopSearch())
@@ -145,46 +232,71 @@ namespace chess
 
         // update searched node count
         m_statistics.searchedNodes++;
+        checkClock();
+
+        // The PV is only set once a move is searched (nodes that return early have no PV)
+        m_pvLength[ply] = 0;
+        // Wether we are still following the PV of the previous iteration (the root always is)
+        bool onPrevPV = Root || m_followPV;
+        m_followPV = false;
 
         // In the root we cannot exit early like this
         if (!Root && (m_repTable->drawBy50MoveRule() || m_repTable->contains(curBoard)))
             return 0; // On repetition we should return draw eval
 
         // Base case (do a quiescent search)
-        if (remainingDepth == 0)
-            return quiescentSearch(curBoard, 0, alpha, beta);
-
-        uint8_t curDepth = m_depths.minDepth - remainingDepth;
+        if (remainingDepth <= 0)
+            return quiescentSearch(curBoard, 0, ply, alpha, beta);
 
         // Look in the transposition table for a usable entry for this board
         key boardHash = curBoard.getHash();
-        TTEntry *transEntry = m_transTable->get(boardHash);
-        bool containsCurBoard = transEntry->containsHash(boardHash);
+        // (a copy, since other threads can overwrite the entry in the table at any time)
+        TTEntry transEntry = m_transTable->get(boardHash);
+        bool containsCurBoard = transEntry.occupied();
         if (containsCurBoard)
         {
             // In the root we need to return a move so we can't return like this
             // TODO: return move if root
-            if (transEntry->evalUsable(curDepth, remainingDepth, alpha, beta))
+            if (transEntry.evalUsable(ply, remainingDepth, alpha, beta))
             {
-                score rootEval = scoreForRootNode(transEntry->eval, curDepth);
+                score rootEval = scoreForRootNode(transEntry.eval, ply);
                 if constexpr (!Root)
                     return rootEval; // use evaluation emediately
 
                 // if this is the root we need to first set the found move
-                m_bestFoundMove = transEntry->move;
+                m_bestFoundMove = transEntry.move;
+                // (the PV of the previous iteration is kept if it starts with the same move)
+                if (m_principalVariation.empty() || m_principalVariation[0] != transEntry.move)
+                    m_principalVariation = {transEntry.move};
+                std::copy(m_principalVariation.begin(), m_principalVariation.end(), m_pvTable[0]);
+                m_pvLength[0] = m_principalVariation.size();
                 // and then return the score
                 return rootEval;
             }
         }
 
         // get the move from the transposition table if available
-        Move TTMove = containsCurBoard ? transEntry->move : Move::Null();
+        Move TTMove = containsCurBoard ? transEntry.move : Move::Null();
         // Either we should reference the search result or a local move (not at root)
         Move &bestMove = Root ? m_bestFoundMove : TTMove;
 
-        MoveList pseudoLegalMoves = curBoard.pseudoLegalMoves<MoveGenType::Normal>();
-        // order the moves to improve pruning
-        m_moveScorer.orderMoves(pseudoLegalMoves, curBoard, TTMove);
+        bool inCheck = curBoard.kingAttacked(curBoard.whitesMove());
+
+        // Only try null moves in null window nodes (a fail high in a PV node is more likely to be wrong)
+        // (passing while in check would be illegal)
+        score nullEval;
+        bool nullWindow = beta - alpha == 1;
+        if (!Root && nullWindow && !inCheck && nullMovePrune(curBoard, remainingDepth, beta, ply, nullEval))
+            return nullEval;
+
+        // The move that lead to this position (used for the countermove and continuation history)
+        Move prevMove = ply > 0 ? m_movesMade[ply - 1] : Move::Null();
+
+        // On the PV of the previous iteration its move is searched first (the TT entry could have been overwritten)
+        Move pvMove = onPrevPV && ply < m_principalVariation.size() ? m_principalVariation[ply] : Move::Null();
+
+        // hands out the moves in order (generating them lazily) to improve pruning
+        MovePicker picker(curBoard, pvMove.isNull() ? TTMove : pvMove, m_moveScorer, ply, prevMove);
 
         // add the current board to the repetition table
         // we use RAII to automatically pop it again when we exit this depth
@@ -195,33 +307,52 @@ namespace chess
         score originalAlpha = alpha;
         bool firstMove = true;
         bool evalFromFullSearch = false;
-        for (const Move &m : pseudoLegalMoves)
+        int moveNumber = 0;
+        for (Move m = picker.next(); !m.isNull(); m = picker.next())
         {
-            BoardState newBoard = curBoard;
-            newBoard.makeMove(m);
-            if (newBoard.kingAttacked(curBoard.whitesMove()))
-                continue; // skip since move was illegal
+            moveNumber++;
+
+            // Quiet moves ordered late are unlikely to be good, so we search them with a reduced depth
+            // (not when we are in check, then every move is an escape attempt)
+            int reduction = 0;
+            if (!firstMove && !inCheck && m.isQuiet())
+                reduction = lateMoveReduction(m, curBoard.whitesMove(), remainingDepth, moveNumber);
+
+            UndoInfo undo = curBoard.makeMove(m);
+            // start loading the TT entry of the child as early as possible
+            m_transTable->prefetch(curBoard.getHash());
+            m_movesMade[ply] = m;
+            m_followPV = !pvMove.isNull() && m == pvMove;
+
+            // moves that give check are never reduced
+            if (reduction > 0 && curBoard.kingAttacked(curBoard.whitesMove()))
+                reduction = 0;
 
             score moveEval;
             if (!firstMove)
             {
                 // PVS null/zero window search
                 score nextBeta = -alpha;
-                moveEval = -minimax<false>(newBoard, remainingDepth - 1, nextBeta - 1, nextBeta);
+                moveEval = -minimax<false>(curBoard, remainingDepth - 1 - reduction, nextBeta - 1, nextBeta, ply + 1);
+                // a reduced move that beats alpha is searched again at the full depth
+                if (reduction > 0 && moveEval > alpha)
+                    moveEval = -minimax<false>(curBoard, remainingDepth - 1, nextBeta - 1, nextBeta, ply + 1);
                 // check if we need a full search
                 evalFromFullSearch = moveEval > alpha && beta - alpha > 1;
                 if (evalFromFullSearch)
                     // full search
-                    moveEval = moveEval = -minimax<false>(newBoard, remainingDepth - 1, -beta, -alpha);
+                    moveEval = moveEval = -minimax<false>(curBoard, remainingDepth - 1, -beta, -alpha, ply + 1);
             }
             else // is firstMove
             {
                 // full search
-                moveEval = moveEval = -minimax<false>(newBoard, remainingDepth - 1, -beta, -alpha);
+                moveEval = moveEval = -minimax<false>(curBoard, remainingDepth - 1, -beta, -alpha, ply + 1);
                 evalFromFullSearch = true;
                 firstMove = false;
             }
 
+            curBoard.unmakeMove(m, undo);
+
             if (stopSearch())
                 // if the search is stopped we need to return to prevent using this moveEval result
                 return 0;
@@ -232,14 +363,19 @@ namespace chess
             {
                 bestEval = moveEval;
                 bestMove = m;
+                updatePV(ply, m);
             }
 
             if (bestEval > beta)
             { // cut-off (The opponent could have chosen a better move in a previous step.)
                 bestMove = m;
 
+                m_statistics.betaCutOffs++;
+                if (moveNumber == 1)
+                    m_statistics.firstMoveCutOffs++;
+
                 // we register the move producing the cut off to improve future move ordering
-                m_moveScorer.registerBetaCutOff(m, curBoard.whitesMove(), remainingDepth);
+                m_moveScorer.registerBetaCutOff(m, curBoard.whitesMove(), remainingDepth, ply, prevMove);
                 break;
             }
 
@@ -255,7 +391,7 @@ namespace chess
             bool isStalemate = !curBoard.kingAttacked(curBoard.whitesMove());
             return isStalemate
                        ? 0                           // stalemate
-                       : -MAX_MATE_SCORE + curDepth; // calculate mate evaluation
+                       : -MAX_MATE_SCORE + ply; // calculate mate evaluation
         }
 
         /*
@@ -273,14 +409,15 @@ namespace chess
         else
             bound = EvalBound::Exact; // Full search was done
 
-        score eval = scoreForCurrentNode(bestEval, curDepth);
+        score eval = scoreForCurrentNode(bestEval, ply);
 
         m_transTable->set(boardHash, TTEntry(eval, remainingDepth, bound, bestMove));
 
         return bestEval;
     }
 
-    score Search::quiescentSearch(const BoardState &curBoard, int extraDepth, score alpha, score beta)
+    template <typename EvalPolicy>
+    score BasicSearch<EvalPolicy>::quiescentSearch(BoardState &curBoard, int extraDepth, uint8_t ply, score alpha, score beta)
     {
         // cancel the search
         if (stopSearch())
@@ -288,41 +425,41 @@ namespace chess
 
         // update searched node count
         m_statistics.searchedNodes++;
+        checkClock();
 
         // Note: no need to check repetition table as each move is a capture (no repetition possible)
 
-        uint8_t curDepth = m_depths.minDepth + extraDepth;
-
         // Look in the transposition table for a usable entry for this board
         key boardHash = curBoard.getHash();
-        TTEntry *transEntry = m_transTable->get(boardHash);
-        bool containsCurBoard = transEntry->containsHash(boardHash);
+        // (a copy, since other threads can overwrite the entry in the table at any time)
+        TTEntry transEntry = m_transTable->get(boardHash);
+        bool containsCurBoard = transEntry.occupied();
         if (containsCurBoard)
         {
             // remaining depth is zero
-            if (transEntry->evalUsable(curDepth, 0, alpha, beta))
-                return scoreForRootNode(transEntry->eval, curDepth);
+            if (transEntry.evalUsable(ply, 0, alpha, beta))
+                return scoreForRootNode(transEntry.eval, ply);
         }
 
         // get the move from the transposition table if available
-        Move TTMove = containsCurBoard ? transEntry->move : Move::Null();
+        Move TTMove = containsCurBoard ? transEntry.move : Move::Null();
 
         // Update max depth statistic
-        m_statistics.reachedDepth = std::max(curDepth, m_statistics.reachedDepth);
+        m_statistics.reachedDepth = std::max(ply, m_statistics.reachedDepth);
 
         // Captures aren't forced so we assume the current positions evaluation as a minimum
         // scale to current players perspective (negamax)
         int8_t sideToMove = (curBoard.whitesMove() ? 1 : -1);
-        score bestEval = m_evalFunc(curBoard) * sideToMove;
+        score bestEval = m_evaluate(curBoard, m_pawnTable) * sideToMove;
 
         if (m_depths.maxQuiescentDepth <= extraDepth)
             return bestEval;
 
-        MoveList pseudoLegalMoves = curBoard.pseudoLegalMoves<MoveGenType::Quiescent>();
-        // order the moves to improve pruning
-        m_moveScorer.orderMoves(pseudoLegalMoves, curBoard, TTMove);
+        // only captures are searched in the quiescent search (the MovePicker skips captures that lose material)
+        const bool capturesOnly = true;
+        MovePicker picker(curBoard, TTMove, m_moveScorer, ply, Move::Null(), capturesOnly);
 
-        for (const Move &m : pseudoLegalMoves)
+        for (Move m = picker.next(); !m.isNull(); m = picker.next())
         {
             if (bestEval > beta)
                 return bestEval; // The opponent could have chosen a better move in a previous step.
@@ -330,13 +467,13 @@ namespace chess
             // max alpha (alpha == -beta on next recursion)
             alpha = std::max(alpha, bestEval);
 
-            BoardState newBoard = curBoard;
-            newBoard.makeMove(m);
-            if (newBoard.kingAttacked(curBoard.whitesMove()))
-                continue; // skip since move was illegal
+            UndoInfo undo = curBoard.makeMove(m);
+            // start loading the TT entry of the child as early as possible
+            m_transTable->prefetch(curBoard.getHash());
 
             // negamax recursion (next depth)
-            int moveEval = -quiescentSearch(newBoard, extraDepth + 1, -beta, -alpha);
+            int moveEval = -quiescentSearch(curBoard, extraDepth + 1, ply + 1, -beta, -alpha);
+            curBoard.unmakeMove(m, undo);
 
             // Update the bestEval and move only when a strictly better option is found
             // (this prevents using pruned options)
@@ -347,6 +484,119 @@ namespace chess
         return bestEval;
     }
 
-    template score Search::minimax<true>(const BoardState &curBoard, int remainingDepth, score alpha, score beta);
-    template score Search::minimax<false>(const BoardState &curBoard, int remainingDepth, score alpha, score beta);
+    namespace
+    {
+        // The late move reductions for each [remainingDepth][moveNumber] (depths and move numbers past the end
+        // use the last entry). Deep searches and moves further down the list are reduced more.
+        struct LateMoveReductionTable
+        {
+            static constexpr int SIZE = 64;
+            uint8_t reductions[SIZE][SIZE] = {};
+
+            LateMoveReductionTable()
+            {
+                for (int depth = 1; depth < SIZE; depth++)
+                    for (int moveNumber = 1; moveNumber < SIZE; moveNumber++)
+                        reductions[depth][moveNumber] = 0.75 + std::log(depth) * std::log(moveNumber) / 2.25;
+            }
+        };
+
+        const LateMoveReductionTable lmrTable;
+    }
+
+    template <typename EvalPolicy>
+    int BasicSearch<EvalPolicy>::lateMoveReduction(Move m, bool whitesMove, int remainingDepth, int moveNumber) const
+    {
+        // Shallow searches and the first few moves are not reduced
+        constexpr int LMR_MIN_DEPTH = 3;
+        constexpr int LMR_MIN_MOVE_NUMBER = 4;
+        // For every this much history score the move is reduced one ply less (but at most MAX_HISTORY_PLIES less).
+        // The history scores only grow during a search, without the cap common quiet moves would stop being reduced.
+        constexpr int HISTORY_PER_PLY = 2048;
+        constexpr int MAX_HISTORY_PLIES = 2;
+
+        if (remainingDepth < LMR_MIN_DEPTH || moveNumber < LMR_MIN_MOVE_NUMBER)
+            return 0;
+
+        constexpr int lastIdx = LateMoveReductionTable::SIZE - 1;
+        int reduction = lmrTable.reductions[std::min(remainingDepth, lastIdx)][std::min(moveNumber, lastIdx)];
+
+        // Moves that often caused a cut-off in other positions are reduced less
+        reduction -= std::min(m_moveScorer.historyScore(m, whitesMove) / HISTORY_PER_PLY, MAX_HISTORY_PLIES);
+
+        // We always search at least one ply before the quiescent search
+        return std::clamp(reduction, 0, remainingDepth - 2);
+    }
+
+    template <typename EvalPolicy>
+    bool BasicSearch<EvalPolicy>::nullMovePrune(BoardState &curBoard, int remainingDepth, score beta, uint8_t ply, score &nullEval)
+    {
+        // Below this depth the null move search is too shallow to be worth it
+        constexpr int NULL_MOVE_MIN_DEPTH = 3;
+        // From this depth a null move cutoff is verified with a (reduced) normal search
+        constexpr int NULL_MOVE_VERIFY_DEPTH = 8;
+
+        if (remainingDepth < NULL_MOVE_MIN_DEPTH || ply < m_nullMoveMinPly)
+            return false;
+
+        // Never two null moves in a row (the second would just undo the first)
+        if (ply > 0 && m_movesMade[ply - 1].isNull())
+            return false;
+
+        // We can't prove a mate by passing
+        if (beta >= MIN_MATE_SCORE || beta <= -MIN_MATE_SCORE)
+            return false;
+
+        bool whitesMove = curBoard.whitesMove();
+
+        // In pawn endgames zugzwang is common (every move makes our position worse), which breaks
+        // the assumption that passing is worse than our best move.
+        const bitboard *ourPieces = curBoard.getPieceSet(whitesMove);
+        if (!(ourPieces[Knight] | ourPieces[Bishop] | ourPieces[Rook] | ourPieces[Queen]))
+            return false;
+
+        score staticEval = m_evaluate(curBoard, m_pawnTable) * (whitesMove ? 1 : -1);
+        if (staticEval <= beta)
+            return false;
+
+        // Adaptive reduction: reduce more for deeper searches and when we are further above beta
+        int reduction = 3 + remainingDepth / 4 + std::min(2, (staticEval - beta) / 200);
+        int nullDepth = std::max(0, remainingDepth - 1 - reduction);
+
+        {
+            // The null move is also a ply for the repetition table
+            RepetitionScope repStateRAII = RepetitionScope(m_repTable, curBoard);
+            UndoInfo undo = curBoard.makeNullMove();
+            m_movesMade[ply] = Move::Null();
+
+            nullEval = -minimax<false>(curBoard, nullDepth, -beta - 1, -beta, ply + 1);
+            curBoard.unmakeNullMove(undo);
+        }
+
+        if (stopSearch() || nullEval <= beta)
+            return false;
+
+        // Don't return unproven mate scores
+        nullEval = std::min(nullEval, (score)(MIN_MATE_SCORE - 1));
+
+        if (remainingDepth < NULL_MOVE_VERIFY_DEPTH)
+            return true;
+
+        // At high depths a wrong cutoff is expensive, so we verify it with a normal search of the same depth
+        // (without null moves in the first part of the tree, otherwise we would verify with the same mistake)
+        int prevNullMoveMinPly = m_nullMoveMinPly;
+        m_nullMoveMinPly = ply + 1 + 3 * nullDepth / 4;
+        score verifyEval = minimax<false>(curBoard, nullDepth, beta, beta + 1, ply);
+        m_nullMoveMinPly = prevNullMoveMinPly;
+
+        return !stopSearch() && verifyEval > beta;
+    }
+
+    template class BasicSearch<StaticEvaluation>;
+    template score BasicSearch<StaticEvaluation>::minimax<true>(BoardState &curBoard, int remainingDepth, score alpha, score beta, uint8_t ply);
+    template score BasicSearch<StaticEvaluation>::minimax<false>(BoardState &curBoard, int remainingDepth, score alpha, score beta, uint8_t ply);
+
+    template class BasicSearch<FunctionEvaluation>;
+    template score BasicSearch<FunctionEvaluation>::minimax<true>(BoardState &curBoard, int remainingDepth, score alpha, score beta, uint8_t ply);
+    template score BasicSearch<FunctionEvaluation>::minimax<false>(BoardState &curBoard, int remainingDepth, score alpha, score beta, uint8_t ply);
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "engine.h"
+
+namespace chess
+{
+    /*
+     * The searches started with startSearch run on a single persistent thread, so the thread reading the
+     * commands can still handle commands (like stop) while the engine is thinking.
+     * The thread is only started once the first search is started.
+     */
+    Engine::~Engine()
+    {
+        stopSearch();
+
+        {
+            std::lock_guard<std::mutex> lock(m_searchMutex);
+            m_shutdown = true;
+        }
+        m_searchCondition.notify_all();
+
+        if (m_searchThread.joinable())
+            m_searchThread.join();
+
+        // (the searches are done, so the helpers are waiting for the next one)
+        {
+            std::lock_guard<std::mutex> lock(m_helperMutex);
+            m_helperShutdown = true;
+        }
+        m_helperCondition.notify_all();
+
+        for (std::thread &helper : m_helperThreads)
+            helper.join();
+    }
+
+    void Engine::startSearch(SearchLimits limits, SearchResultCallback onDone, Search::IterationCallback onIteration)
+    {
+        // Only one search can run at a time
+        finishSearch();
+
+        std::lock_guard<std::mutex> lock(m_searchMutex);
+        if (!m_searchThread.joinable())
+            m_searchThread = std::thread(&Engine::searchThreadLoop, this);
+
+        m_searching = true;
+        m_searchInfinite = limits.infinite;
+        m_stopRequested = false;
+        m_searchJob = [this, limits, onDone, onIteration]()
+        {
+            auto [move, eval, stats] = findBestMove(limits, onIteration);
+
+            // An infinite search can end by itself (depth limit or a forced mate), the result is still only reported after stop
+            if (limits.infinite)
+            {
+                std::unique_lock<std::mutex> lock(m_searchMutex);
+                m_searchCondition.wait(lock, [this]()
+                                       { return m_stopRequested || m_shutdown; });
+            }
+
+            onDone(move, eval, stats);
+        };
+        m_searchCondition.notify_all();
+    }
+
+    void Engine::stopSearch()
+    {
+        std::lock_guard<std::mutex> lock(m_searchMutex);
+        // Only stop searches that are running (or about to), a later search should not be stopped
+        if (!m_searching)
+            return;
+
+        m_stopRequested = true;
+        if (m_mainSearch != nullptr)
+            m_mainSearch->stop();
+        // (wakes up a finished infinite search waiting for the stop)
+        m_searchCondition.notify_all();
+    }
+
+    void Engine::waitForSearch()
+    {
+        std::unique_lock<std::mutex> lock(m_searchMutex);
+        m_searchCondition.wait(lock, [this]()
+                               { return !m_searching; });
+    }
+
+    void Engine::finishSearch()
+    {
+        bool infinite;
+        {
+            std::lock_guard<std::mutex> lock(m_searchMutex);
+            infinite = m_searching && m_searchInfinite;
+        }
+
+        // (searches are started by the same thread that finishes them, so the search can't change in between)
+        if (infinite)
+            stopSearch();
+        waitForSearch();
+    }
+
+    void Engine::searchThreadLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_searchMutex);
+        while (true)
+        {
+            m_searchCondition.wait(lock, [this]()
+                                   { return m_searchJob || m_shutdown; });
+
+            if (!m_searchJob)
+                return; // shutting down
+
+            std::function<void()> job = std::move(m_searchJob);
+            m_searchJob = nullptr;
+
+            // findBestMove locks the mutex itself (to register the main search)
+            lock.unlock();
+            job();
+            lock.lock();
+
+            m_searching = false;
+            m_searchCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,186 @@
+#include "transposition.h"
+
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace chess
+{
+    /*
+     * Header of a saved transposition table file.
+     * The buckets follow at TT_FILE_DATA_OFFSET (page aligned so they can be mapped directly).
+     */
+    struct TTFileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t bucketBytes; // to detect files written with a different bucket layout
+        uint64_t numBuckets;
+        uint8_t generation;
+    };
+
+    constexpr char TT_FILE_MAGIC[8] = {'C', 'B', 'B', '_', 'T', 'T', '\0', '\0'};
+    constexpr uint32_t TT_FILE_VERSION = 1;
+    constexpr size_t TT_FILE_DATA_OFFSET = 4096;
+
+    void TranspositionTable::allocate(int mbSize)
+    {
+        size = (size_t(mbSize) * 1024 * 1024) / sizeof(TTBucket);
+        size_t bytes = size * sizeof(TTBucket);
+
+#if defined(__linux__)
+        // Anonymous mappings are zeroed by the kernel and only backed by memory once touched.
+        // We also ask for transparent huge pages which greatly reduces the TLB misses on random probes.
+        void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+#if defined(MADV_HUGEPAGE)
+            madvise(mem, bytes, MADV_HUGEPAGE);
+#endif
+            table = static_cast<TTBucket *>(mem);
+            m_mapping = mem;
+            m_mappingBytes = bytes;
+            return;
+        }
+#endif
+
+        // Fallback (non linux or mmap failed)
+        table = new TTBucket[size];
+    }
+
+    void TranspositionTable::free()
+    {
+        if (table == nullptr)
+            return;
+
+#if defined(__linux__)
+        if (m_mapping != nullptr)
+            munmap(m_mapping, m_mappingBytes);
+        else
+            delete[] table;
+#else
+        delete[] table;
+#endif
+
+        table = nullptr;
+        m_mapping = nullptr;
+        m_mappingBytes = 0;
+    }
+
+    void TranspositionTable::clear(int maxThreads)
+    {
+        // Every thread clears at least this much (the default 64mb table is cleared on a single thread)
+        constexpr size_t MIN_BYTES_PER_THREAD = 256 * 1024 * 1024;
+        size_t bytes = size * sizeof(TTBucket);
+        int numThreads = std::clamp<size_t>(bytes / MIN_BYTES_PER_THREAD, 1, std::max(1, maxThreads));
+        size_t bucketsPerThread = (size + numThreads - 1) / numThreads;
+
+        // Each thread zeroes its own contiguous chunk of buckets (zero means an empty slot)
+        auto clearChunk = [this, bucketsPerThread](int idx)
+        {
+            size_t start = idx * bucketsPerThread;
+            size_t end = std::min(size, start + bucketsPerThread);
+            if (start < end)
+                std::memset(static_cast<void *>(&table[start]), 0, (end - start) * sizeof(TTBucket));
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 1; i < numThreads; i++)
+            threads.emplace_back(clearChunk, i);
+
+        // The calling thread also clears a chunk
+        clearChunk(0);
+
+        for (std::thread &t : threads)
+            t.join();
+    }
+
+    bool TranspositionTable::save(const std::string &path) const
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+
+        TTFileHeader header = {};
+        std::memcpy(header.magic, TT_FILE_MAGIC, sizeof(TT_FILE_MAGIC));
+        header.version = TT_FILE_VERSION;
+        header.bucketBytes = sizeof(TTBucket);
+        header.numBuckets = size;
+        header.generation = m_curSearchGeneration;
+
+        // Pad the header up to the (page aligned) start of the data
+        std::vector<char> headerPage(TT_FILE_DATA_OFFSET, 0);
+        std::memcpy(headerPage.data(), &header, sizeof(header));
+        out.write(headerPage.data(), headerPage.size());
+
+        out.write(reinterpret_cast<const char *>(table), size * sizeof(TTBucket));
+        return bool(out);
+    }
+
+    bool TranspositionTable::load(const std::string &path)
+    {
+        std::error_code ec;
+        uintmax_t fileBytes = std::filesystem::file_size(path, ec);
+        if (ec || fileBytes < TT_FILE_DATA_OFFSET)
+            return false;
+
+        std::ifstream in(path, std::ios::binary);
+        TTFileHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return false;
+
+        // The tables are allocated in whole megabytes (see allocate), so any other number of buckets is corrupt.
+        // The bucket count is checked against the file size by dividing, a crafted count can't overflow that.
+        constexpr uint64_t BUCKETS_PER_MB = 1024 * 1024 / sizeof(TTBucket);
+        uintmax_t dataBytes = fileBytes - TT_FILE_DATA_OFFSET;
+        bool validHeader = std::memcmp(header.magic, TT_FILE_MAGIC, sizeof(TT_FILE_MAGIC)) == 0 &&
+                           header.version == TT_FILE_VERSION &&
+                           header.bucketBytes == sizeof(TTBucket) &&
+                           header.numBuckets > 0 &&
+                           header.numBuckets % BUCKETS_PER_MB == 0 &&
+                           header.numBuckets <= dataBytes / sizeof(TTBucket) &&
+                           header.numBuckets * sizeof(TTBucket) == dataBytes;
+        if (!validHeader)
+            return false;
+
+#if defined(__linux__)
+        // Map the file copy on write, so the search can modify the table without touching the file
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        void *mem = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping stays valid after closing
+        if (mem == MAP_FAILED)
+            return false;
+
+        free();
+        m_mapping = mem;
+        m_mappingBytes = fileBytes;
+        table = reinterpret_cast<TTBucket *>(static_cast<char *>(mem) + TT_FILE_DATA_OFFSET);
+#else
+        TTBucket *loaded = new TTBucket[header.numBuckets];
+        in.seekg(TT_FILE_DATA_OFFSET);
+        if (!in.read(reinterpret_cast<char *>(loaded), header.numBuckets * sizeof(TTBucket)))
+        {
+            delete[] loaded;
+            return false;
+        }
+
+        free();
+        table = loaded;
+#endif
+
+        size = header.numBuckets;
+        m_curSearchGeneration = header.generation;
+        return true;
+    }
+}
@@ -0,0 +1,193 @@
+#include "engine.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+namespace chess
+{
+    /*
+     * The commands of the UCI protocol, so the engine can be run by chess GUIs and tournament managers directly.
+     * They are dispatched by runCmd next to the custom commands (isready, stop, go and quit are shared with those).
+     * The uci command switches the output of go to UCI: an info line for every completed iteration and the bestmove.
+     */
+
+    // The info line of a completed iteration, the score is from the perspective of the side to move
+    static std::string uciInfo(const Search::SearchStats &stats, Eval eval, Time elapsed, bool whitesMove, double ttFullness)
+    {
+        int sideToMove = whitesMove ? 1 : -1;
+
+        std::ostringstream out;
+        out << "info depth " << (int)stats.minDepth << " seldepth " << (int)stats.reachedDepth;
+        if (eval.type == Eval::Type::MATE)
+            out << " score mate " << eval.movesTillMate() * sideToMove;
+        else
+            out << " score cp " << eval.scoreValue() * sideToMove;
+
+        out << " nodes " << stats.searchedNodes
+            << " nps " << stats.searchedNodes * 1000 / std::max<Time>(1, elapsed)
+            << " time " << elapsed
+            << " hashfull " << (int)(ttFullness * 1000)
+            << " pv";
+        for (Move m : stats.principalVariation)
+            out << " " << m.toUCI();
+        out << "\n";
+        return out.str();
+    }
+
+    void Engine::uciCmd()
+    {
+        m_uciMode = true;
+        std::cout << "id name ChessBitBoards\n"
+                  << "id author Bas Jansweijer\n"
+                  << "option name Hash type spin default " << m_transTable.sizeMbs() << " min 1 max 65536\n"
+                  << "option name Threads type spin default " << m_threads << " min 1 max 256\n"
+                  << "uciok" << std::endl;
+    }
+
+    // position startpos|fen [fen] [moves [uciMove]...]
+    void Engine::positionCmd(std::istringstream &args)
+    {
+        std::string type;
+        args >> type;
+
+        BoardState board;
+        std::string token;
+        if (type == "fen")
+        {
+            // The fen consists of multiple words (up to the moves)
+            std::string fen;
+            while (args >> token && token != "moves")
+                fen += (fen.empty() ? "" : " ") + token;
+            board = BoardState(fen);
+        }
+        else if (type == "startpos")
+            args >> token;
+        else
+        {
+            std::cout << "info string Invalid position type '" << type << "'" << std::endl;
+            return;
+        }
+
+        // Unlike setPosition the transposition table is kept, since the position is send before every search
+        // (ucinewgame clears it)
+        finishSearch();
+        m_currentBoard = board;
+        m_repTable.clear();
+
+        if (token != "moves")
+            return;
+
+        // makeMove also keeps track of the repetitions
+        std::string move;
+        while (args >> move)
+        {
+            if (!makeMove(move))
+            {
+                std::cout << "info string '" << move << "' is not a legal move!" << std::endl;
+                break;
+            }
+        }
+    }
+
+    // setoption name [name] value [value]
+    void Engine::setOptionCmd(std::istringstream &args)
+    {
+        std::string token, option;
+        args >> token;
+        while (args >> token && token != "value")
+            option += (option.empty() ? "" : " ") + token;
+
+        int value = 0;
+        if (!(args >> value))
+        {
+            std::cout << "info string Missing value for option '" << option << "'" << std::endl;
+            return;
+        }
+
+        if (option == "Hash")
+            setTranspositionTableSize(std::max(1, value));
+        else if (option == "Threads")
+        {
+            finishSearch();
+            m_threads = std::max(1, value);
+        }
+        else
+            std::cout << "info string Unknown option '" << option << "'" << std::endl;
+    }
+
+    /*
+     * go [wtime x] [btime x] [winc x] [binc x] [movestogo x] [movetime x] [depth x] [nodes x] [infinite]
+     * (the arguments can be given in any order)
+     * Without any time (movetime or clock) the search runs until it is stopped or reaches its depth or node limit.
+     */
+    void Engine::goCmd(std::istringstream &args)
+    {
+        ClockState clock(0, 0);
+        bool hasClock = false;
+        Time moveTime = 0;
+        SearchLimits limits(INFINITE_TIME);
+
+        std::string arg;
+        while (args >> arg)
+        {
+            if (arg == "wtime" && args >> clock.wtime)
+                hasClock = true;
+            else if (arg == "btime" && args >> clock.btime)
+                hasClock = true;
+            else if (arg == "winc")
+                args >> clock.winc;
+            else if (arg == "binc")
+                args >> clock.binc;
+            else if (arg == "movestogo")
+                args >> clock.movesToGo;
+            else if (arg == "movetime")
+                args >> moveTime;
+            else if (arg == "depth" && args >> limits.depth)
+                limits.depth = std::clamp(limits.depth, 1, TTEntry::MAX_DEPTH);
+            else if (arg == "nodes")
+                args >> limits.nodes;
+            else if (arg == "infinite")
+                limits.infinite = true;
+        }
+
+        if (limits.infinite)
+            limits.time = INFINITE_TIME;
+        else if (moveTime > 0)
+            limits.time = moveTime;
+        else if (hasClock)
+        {
+            int moveCounter = m_currentBoard.ply() / 2;
+            limits.time = m_currentBoard.whitesMove()
+                              ? clock.currentMoveTime<true>(moveCounter)
+                              : clock.currentMoveTime<false>(moveCounter);
+        }
+
+        if (m_uciMode)
+        {
+            bool whitesMove = m_currentBoard.whitesMove();
+            startSearch(
+                limits, [](Move move, Eval, const Search::SearchStats &)
+                {
+                    // (printed at once, since the command loop can print at the same time, e.g. readyok)
+                    std::string bestMove = "bestmove " + (move.isNull() ? std::string("0000") : move.toUCI()) + "\n";
+                    std::cout << bestMove << std::flush; },
+                [this, whitesMove](const Search::SearchStats &stats, Eval eval, Time elapsed)
+                { std::cout << uciInfo(stats, eval, elapsed, whitesMove, m_transTable.fullNess()) << std::flush; });
+            return;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        startSearch(limits, [this, startTime](Move move, Eval eval, const Search::SearchStats &info)
+                    {
+            std::chrono::duration<double> spendTime = std::chrono::steady_clock::now() - startTime;
+            double ttFullness = m_transTable.fullNess();
+
+            // (printed at once, since the command loop can print at the same time)
+            std::ostringstream out;
+            out << "info (eval: " << eval << ", searchinfo: " << info
+                << ", ttFullness: " << ttFullness
+                << ", spend time: " << spendTime.count() << ")\n";
+            out << "bestmove " << move.toUCI() << "\n";
+            std::cout << out.str() << std::flush; });
+    }
+}
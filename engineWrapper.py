@@ -4,6 +4,8 @@ import cairosvg
 import io
 from tkinter import Tk, Canvas, PhotoImage
 import re
+import queue
+import threading
 from time import sleep
 
 
@@ -49,28 +51,66 @@ class ChessBoardGUI:
 
 class EngineConfig:
     transpositionTableMbs = 64
+    threads = 1
 
 
 class ChessEngine:
     def __init__(self, engine_path, config:EngineConfig=EngineConfig()):
         self.engine_path = engine_path
-        args = ["-ttMbs", str(config.transpositionTableMbs)]
+        args = ["-ttMbs", str(config.transpositionTableMbs), "-threads", str(config.threads)]
         self.process = subprocess.Popen([self.engine_path] + args, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
-    
-    def runCmd(self, cmd):
-        self.process.stdin.write(cmd + '\n')
-        self.process.stdin.flush()
-        response = self.process.stdout.readline().strip()
+
+        # The engine searches on its own thread and keeps reading commands (like stop) while thinking.
+        # The output is read on a seperate thread so we can send commands without waiting on a response.
+        self.lines = queue.Queue()
+        self.reader = threading.Thread(target=self._readOutput, daemon=True)
+        self.reader.start()
+
+        # The engine can be used from multiple threads (like the bot's thinker and game threads), so only one
+        # command and its response are exchanged at a time. Otherwise one thread could take the response
+        # meant for the other (like a readyok or bestmove). stop has no response and is sent without it.
+        self.exchangeLock = threading.RLock()
+        self.writeLock = threading.Lock()
+
+    def _readOutput(self):
+        for line in self.process.stdout:
+            self.lines.put(line.strip())
+        # The engine closed its output
+        self.lines.put('')
+
+    def send(self, cmd):
+        with self.writeLock:
+            self.process.stdin.write(cmd + '\n')
+            self.process.stdin.flush()
+
+    # Returns the next line that is not an info line (timeout in seconds, None waits forever)
+    def readResponse(self, timeout=None):
+        response = self.lines.get(timeout=timeout)
         while response.startswith("info"):
             print(response)
-            response = self.process.stdout.readline().strip()
-        
+            response = self.lines.get(timeout=timeout)
+
         if response == '':
             print("ENGINE CRASH?!?!")
             print(self.process.stderr.read())
             raise Exception("Engine crash?")
 
         return response
+
+    def runCmd(self, cmd):
+        with self.exchangeLock:
+            self.send(cmd)
+            return self.readResponse()
+
+    # The engine answers right away, but the exchange waits for a go of another thread to get its bestmove
+    def isReady(self, timeout=None):
+        with self.exchangeLock:
+            self.send("isready")
+            return self.readResponse(timeout) == "readyok"
+
+    # Stops the search started with startGo (waitBestMove still returns the best move found)
+    def stop(self):
+        self.send("stop")
     
     def benchDepth(self, depth):
         response = self.runCmd(f"bench depth {depth}")
@@ -107,15 +147,27 @@ class ChessEngine:
         print(f"failed on response: '{response}'")
         raise Exception("bestMove Not parsed correctly")
     
-    # Times all in seconds
-    def go(self, wtimeSeconds: float, btimeSeconds: float, wincSeconds: float, bincSeconds: float):
+    # Times all in seconds, returns right away (the move is returned by waitBestMove)
+    # The exchange lasts until waitBestMove, which has to be called from the same thread
+    def startGo(self, wtimeSeconds: float, btimeSeconds: float, wincSeconds: float, bincSeconds: float):
         def toMS(t):
             return int(t*1000)
         
         print("Start thinking")
         
         cmd = f"go wtime {toMS(wtimeSeconds)} btime {toMS(btimeSeconds)} winc {toMS(wincSeconds)} binc {toMS(bincSeconds)}"
-        response = self.runCmd(cmd)
+        self.exchangeLock.acquire()
+        try:
+            self.send(cmd)
+        except:
+            self.exchangeLock.release()
+            raise
+
+    def waitBestMove(self):
+        try:
+            response = self.readResponse()
+        finally:
+            self.exchangeLock.release()
 
         pattern = r'bestmove (\S+)'
         match = re.search(pattern, response)
@@ -126,9 +178,19 @@ class ChessEngine:
         print("failed on response:", response)
         raise Exception("go Not parsed correctly")
 
+    # Times all in seconds
+    def go(self, wtimeSeconds: float, btimeSeconds: float, wincSeconds: float, bincSeconds: float):
+        self.startGo(wtimeSeconds, btimeSeconds, wincSeconds, bincSeconds)
+        return self.waitBestMove()
+
     def makeMove(self, uci_move):
         self.runCmd(f"makeMove {uci_move}")
 
     def quit(self):
-        self.runCmd("quit")
+        # A running search is stopped by the engine, we skip its result
+        # (a go of another thread still gets its bestmove first)
+        with self.exchangeLock:
+            self.send("quit")
+            while self.readResponse() != "done":
+                pass
         self.process.terminate()
\ No newline at end of file
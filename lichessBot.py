@@ -65,6 +65,25 @@ def setEngineToCurrentPosition(engine: ChessEngine, moves):
 
 
 
+# Runs on a seperate thread, so the game stream is still handled while the engine thinks
+def makeEngineMove(engine: ChessEngine, game_id, wtime, btime, winc, binc, gameOver: threading.Event, failed: threading.Event):
+    engineMove = engine.go(wtime, btime, winc, binc)
+    if gameOver.is_set():
+        return # the search was stopped because the game ended
+
+    print("Engine position: ", engine.getPosition())
+
+    try:
+        client.bots.make_move(game_id, engineMove)
+    except Exception as e:
+        print(f"Error could not make move {engineMove}")
+        print("Engine position: ", engine.getPosition())
+        print(e)
+        # Retry with a new engine (the game loop stops on its next event)
+        failed.set()
+        engine.quit()
+        threading.Thread(target=playGame, args=(game_id,)).start()
+
 def playGame(game_id):
     global gameCounter
     gameCounter += 1
@@ -105,12 +124,24 @@ def playGame(game_id):
             print(e)
             return
 
+    thinker = None
+    gameOver = threading.Event()
+    failed = threading.Event()
     for event in client.bots.stream_game_state(game_id):
+        if failed.is_set():
+            # The move failed and the game was restarted with a new engine
+            return
+
         match event['type']:
             case 'gameFull':
                 gameStartEvent(event)
             case 'gameState':
                 if event['status'] != 'started':
+                    # The game can end while we are thinking (resign, abort, flag), so we stop the search
+                    gameOver.set()
+                    if thinker is not None and thinker.is_alive():
+                        engine.stop()
+                        thinker.join()
                     break
                 
                 # Catch up to current position
@@ -138,20 +169,9 @@ def playGame(game_id):
                 winc = event['winc'].timestamp()
                 binc = event['binc'].timestamp()
                 print(f"Time w: {wtime} b: {btime}, inc: {(winc, binc)}")
-                engineMove = engine.go(wtime, btime, winc, binc)
-                print("Engine position: ", engine.getPosition())
-                
-                try:
-                    client.bots.make_move(game_id, engineMove)
-                except Exception as e:
-                    print(f"Error could not make move {engineMove}")
-                    print("Engine position: ", engine.getPosition())
-                    engine.quit()
-                    print(e)
-                    # Retry
-                    playGame(game_id)
-                    break
-                
+                thinker = threading.Thread(target=makeEngineMove, args=(engine, game_id, wtime, btime, winc, binc, gameOver, failed))
+                thinker.start()
+
             case "chatLine":
                 pass
             case "opponentGone":
@@ -159,6 +179,9 @@ def playGame(game_id):
             case _:
                 print(f"unknown event type in game {event['type']}")
 
+    if failed.is_set():
+        return
+
     # game done
     print("engine Quit")
     engine.quit()
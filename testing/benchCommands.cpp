@@ -0,0 +1,79 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "engine.h"
+
+/*
+ * Command throughput of Engine::runCmd, for pipelines which feed the engine many positions and moves.
+ * For every fen the commands set the position, play a legal move and read the position back
+ * (using both the custom and the UCI commands). The output of the engine is discarded while measuring.
+ */
+
+// Discards everything written to it
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+};
+
+constexpr int REPETITIONS = 5;
+
+int main(int argc, char *argv[])
+{
+    // The quick mode is usefull for faster itteration when experimenting with optimizations
+    bool quickMode = false;
+
+    // Loop through command-line arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--quick")
+        {
+            quickMode = true;
+        }
+    }
+
+    std::string fensPath = quickMode ? "testing/fens10.txt" : "testing/fens10000.txt";
+
+    std::vector<std::string> commands;
+    std::ifstream fensFile(fensPath);
+    std::string fen;
+    while (getline(fensFile, fen))
+    {
+        chess::MoveList moves = chess::BoardState(fen).legalMoves();
+        if (moves.size() == 0)
+            continue;
+
+        std::string move = moves[0].toUCI();
+        commands.push_back("setPosition " + fen);
+        commands.push_back("makeMove " + move);
+        commands.push_back("getPosition");
+        commands.push_back("position fen " + fen + " moves " + move);
+    }
+
+    // A small transposition table, since setPosition clears it
+    chess::Engine::EngineConfig config;
+    config.transpositionTableMBs = 1;
+    chess::Engine engine(config);
+
+    NullBuffer nullBuffer;
+    std::streambuf *coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < REPETITIONS; i++)
+        for (const std::string &cmd : commands)
+            engine.runCmd(cmd);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+    std::cout.rdbuf(coutBuffer);
+
+    size_t numCommands = commands.size() * REPETITIONS;
+    std::cout << "Ran " << numCommands << " commands in " << seconds.count() << " seconds" << std::endl;
+    std::cout << "Commands per second: " << (int)(numCommands / seconds.count())
+              << " (" << 1e6 * seconds.count() / numCommands << " us per command)" << std::endl;
+    return 0;
+}
@@ -64,8 +64,11 @@ void benchTestFens(int testDepth, std::string fensPath)
 
     double avgNodes = static_cast<double>(totalNodes) / numFens;
     double avgTime = totalTime / numFens;
+    // nodes per second over all searches combined (used to compare search speed optimizations)
+    int nodesPerSecond = totalNodes / totalTime;
     std::cout << "\nAverage nodes searched: " << avgNodes
-              << "\nAverage time: " << avgTime << std::endl;
+              << "\nAverage time: " << avgTime
+              << "\nnps: " << nodesPerSecond << std::endl;
 }
 
 int main(int argc, char *argv[])
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "engine.h"
+
+/*
+ * Thread scaling of the lazy SMP search.
+ * Searches the positions to a fixed depth (time to depth) with 1, 2, 4, ... threads (up to the number of cores)
+ * and prints the nodes per second and the speedup compared to a single thread.
+ * Usage: benchThreads [--quick] [--depth d] [--positions n] [--maxThreads t]
+ */
+
+constexpr int DEFAULT_DEPTH = 9;
+constexpr int DEFAULT_POSITIONS = 50;
+
+int main(int argc, char *argv[])
+{
+    bool quickMode = false;
+    int depth = DEFAULT_DEPTH;
+    int numPositions = DEFAULT_POSITIONS;
+    int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--quick")
+            quickMode = true;
+        else if (arg == "--depth" && i + 1 < argc)
+            depth = std::stoi(argv[++i]);
+        else if (arg == "--positions" && i + 1 < argc)
+            numPositions = std::stoi(argv[++i]);
+        else if (arg == "--maxThreads" && i + 1 < argc)
+            maxThreads = std::stoi(argv[++i]);
+    }
+
+    std::string fensPath = quickMode ? "testing/fens10.txt" : "testing/fens10000.txt";
+    std::vector<std::string> fens;
+    std::ifstream fensFile(fensPath);
+    std::string fen;
+    while ((int)fens.size() < numPositions && getline(fensFile, fen))
+        fens.push_back(fen);
+
+    std::cout << "Searching " << fens.size() << " positions to depth " << depth << std::endl;
+
+    double singleThreadSeconds = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        chess::Engine::EngineConfig config;
+        config.threads = threads;
+        chess::Engine engine(config);
+
+        chess::SearchLimits limits(chess::INFINITE_TIME);
+        limits.depth = depth;
+
+        uint64_t totalNodes = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string &positionFen : fens)
+        {
+            engine.setPosition(chess::BoardState(positionFen));
+            auto [move, eval, stats] = engine.findBestMove(limits);
+            totalNodes += stats.searchedNodes;
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+        if (threads == 1)
+            singleThreadSeconds = seconds.count();
+
+        std::cout << threads << " threads: " << seconds.count() << " seconds, "
+                  << totalNodes << " nodes, " << (uint64_t)(totalNodes / seconds.count()) << " nps, "
+                  << "time to depth speedup " << singleThreadSeconds / seconds.count() << "x" << std::endl;
+    }
+
+    return 0;
+}
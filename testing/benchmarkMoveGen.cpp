@@ -6,6 +6,10 @@
 #include "chess.h"
 #include "toolUtils.h"
 
+using MoveGenType = chess::BoardState::MoveGenType;
+
+// Unmake uses makeMove + unmakeMove on a single board instead of copying the board for each move
+template <MoveGenType GenType, bool Unmake>
 int perft(chess::BoardState &b, int depth)
 {
     if (depth == 0)
@@ -13,21 +17,31 @@ int perft(chess::BoardState &b, int depth)
 
     int nodes = 1;
 
-    constexpr chess::BoardState::MoveGenType NORMAL = chess::BoardState::MoveGenType::Normal;
-
-    for (auto m : b.pseudoLegalMoves<NORMAL>())
+    for (auto m : b.pseudoLegalMoves<GenType>())
     {
-        chess::BoardState newB = b;
-        newB.makeMove(m);
-        if (newB.kingAttacked(!newB.whitesMove()))
-            continue;
+        if constexpr (Unmake)
+        {
+            chess::UndoInfo undo = b.makeMove(m);
+            if (GenType != MoveGenType::Normal || !b.kingAttacked(!b.whitesMove()))
+                nodes += perft<GenType, Unmake>(b, depth - 1);
+            b.unmakeMove(m, undo);
+        }
+        else
+        {
+            chess::BoardState newB = b;
+            newB.makeMove(m);
+            // The legal generator never produces moves which leave our king in check
+            if (GenType == MoveGenType::Normal && newB.kingAttacked(!newB.whitesMove()))
+                continue;
 
-        nodes += perft(newB, depth - 1);
+            nodes += perft<GenType, Unmake>(newB, depth - 1);
+        }
     }
 
     return nodes;
 }
 
+template <MoveGenType GenType, bool Unmake>
 int benchMoveGen(std::string fensFile, int depth = 4)
 {
     std::ifstream fens(fensFile);
@@ -40,7 +54,7 @@ int benchMoveGen(std::string fensFile, int depth = 4)
         chess::BoardState b(fen);
         {
             utils::Timer t;
-            searchedNodes += perft(b, depth);
+            searchedNodes += perft<GenType, Unmake>(b, depth);
         }
     }
 
@@ -53,6 +67,10 @@ int main(int argc, char *argv[])
 {
     // The quick mode is usefull for faster itteration when experimenting with optimizations
     bool quickMode = false;
+    // Use the pseudo legal generator (+ kingAttacked check) instead of the legal generator
+    bool pseudoLegal = false;
+    // Use makeMove + unmakeMove instead of copying the board for each move
+    bool unmake = false;
 
     // Loop through command-line arguments
     for (int i = 1; i < argc; ++i)
@@ -63,10 +81,24 @@ int main(int argc, char *argv[])
         {
             quickMode = true;
         }
+        else if (arg == "--pseudo")
+        {
+            pseudoLegal = true;
+        }
+        else if (arg == "--unmake")
+        {
+            unmake = true;
+        }
     }
 
     std::string fensFile = quickMode ? "testing/fens10.txt" : "testing/fens10000.txt";
 
-    int nps = benchMoveGen(fensFile);
+    int nps;
+    if (unmake)
+        nps = pseudoLegal ? benchMoveGen<MoveGenType::Normal, true>(fensFile)
+                          : benchMoveGen<MoveGenType::Legal, true>(fensFile);
+    else
+        nps = pseudoLegal ? benchMoveGen<MoveGenType::Normal, false>(fensFile)
+                          : benchMoveGen<MoveGenType::Legal, false>(fensFile);
     std::cout << "nps: " << nps << std::endl;
 }
\ No newline at end of file
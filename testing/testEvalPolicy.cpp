@@ -0,0 +1,70 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include "search.h"
+
+#define GREEN "\033[32m"
+#define RED "\033[31m"
+#define RESET "\033[0m"
+
+/*
+ * Checks that the search gives the same result with the type erased evaluation (FunctionEvaluation)
+ * as with the evaluation policy the engine uses (StaticEvaluation) when both wrap Evaluator::evaluate.
+ */
+
+constexpr int DEPTH = 5;
+
+template <typename EvalPolicy>
+std::pair<chess::score, uint64_t> searchPosition(const chess::BoardState &board, EvalPolicy evalPolicy)
+{
+    chess::RepetitionTable repTable;
+    chess::TranspositionTable transTable(16);
+
+    typename chess::BasicSearch<EvalPolicy>::SearchConfig config;
+    config.evaluate = evalPolicy;
+    config.repTable = &repTable;
+    config.transTable = &transTable;
+
+    chess::BasicSearch<EvalPolicy> search(board, config);
+    search.setMaxQuiescentDepth(DEPTH + 2);
+
+    chess::BoardState b = board;
+    chess::score result = search.template minimax<true>(b, DEPTH);
+    return {result, search.getStats().searchedNodes};
+}
+
+int main()
+{
+    std::ifstream fensFile("testing/fens10.txt");
+    std::string fen;
+    int mismatches = 0;
+    int numPositions = 0;
+    while (getline(fensFile, fen))
+    {
+        chess::BoardState board(fen);
+        numPositions++;
+
+        auto [staticScore, staticNodes] = searchPosition(board, chess::StaticEvaluation());
+        // (the function evaluation doesn't use the pawn hash table)
+        auto evalFunction = [](const chess::BoardState &b)
+        { return chess::Evaluator::evaluate(b); };
+        auto [functionScore, functionNodes] = searchPosition(board, chess::FunctionEvaluation{evalFunction});
+
+        if (staticScore != functionScore || staticNodes != functionNodes)
+        {
+            std::cout << RED << "Mismatch on " << fen << " static eval: " << staticScore << " (" << staticNodes
+                      << " nodes) function eval: " << functionScore << " (" << functionNodes << " nodes)" << RESET << std::endl;
+            mismatches++;
+        }
+    }
+
+    if (mismatches != 0)
+    {
+        std::cout << RED << mismatches << " of " << numPositions << " positions gave different results" << RESET << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN << "Both evaluation policies gave the same results on " << numPositions << " positions" << RESET << std::endl;
+    return 0;
+}
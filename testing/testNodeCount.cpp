@@ -0,0 +1,83 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+
+#include "engine.h"
+
+#define GREEN "\033[32m"
+#define RED "\033[31m"
+#define RESET "\033[0m"
+
+/*
+ * Node count regression for the search.
+ * Searches every position to a fixed depth and compares the total number of searched nodes to the expected count.
+ * Changes to the move ordering or pruning change this count. When that is intended check that the change is an
+ * improvement (less nodes and a higher first move cut-off rate) and update the expected counts bellow.
+ */
+
+constexpr int DEPTH = 5;
+constexpr uint64_t EXPECTED_NODES = 98409797;
+constexpr uint64_t EXPECTED_NODES_QUICK = 76348;
+
+int main(int argc, char *argv[])
+{
+    // The quick mode is usefull for faster itteration when experimenting with optimizations
+    bool quickMode = false;
+
+    // Loop through command-line arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--quick")
+        {
+            quickMode = true;
+        }
+    }
+
+    std::string fensPath = quickMode ? "testing/fens10.txt" : "testing/fens10000.txt";
+    uint64_t expectedNodes = quickMode ? EXPECTED_NODES_QUICK : EXPECTED_NODES;
+
+    // A small transposition table, since it is cleared for every position
+    chess::Engine::EngineConfig config;
+    config.transpositionTableMBs = 16;
+    chess::Engine engine(config);
+
+    uint64_t totalNodes = 0;
+    uint64_t totalCutOffs = 0;
+    uint64_t totalFirstMoveCutOffs = 0;
+    int numPositions = 0;
+
+    std::ifstream fensFile(fensPath);
+    std::string fen;
+    while (getline(fensFile, fen))
+    {
+        engine.setPosition(chess::BoardState(fen));
+        std::optional<chess::Engine::BenchResult> result = engine.bench<chess::Engine::BenchType::Depth>(DEPTH);
+        if (!result)
+        {
+            std::cout << RED << "Search failed on fen: " << fen << RESET << std::endl;
+            return 1;
+        }
+
+        totalNodes += result->searchedNodes;
+        totalCutOffs += result->betaCutOffs;
+        totalFirstMoveCutOffs += result->firstMoveCutOffs;
+        numPositions++;
+    }
+
+    std::cout << "Searched " << numPositions << " positions to depth " << DEPTH << std::endl;
+    std::cout << "Total nodes: " << totalNodes << std::endl;
+    std::cout << "Beta cut-offs: " << totalCutOffs << " ("
+              << 100.0 * totalFirstMoveCutOffs / std::max<uint64_t>(1, totalCutOffs) << "% on the first move)" << std::endl;
+
+    if (totalNodes != expectedNodes)
+    {
+        std::cout << RED << "Expected " << expectedNodes << " nodes but searched " << totalNodes << RESET << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN << "Node count matches" << RESET << std::endl;
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "chess.h"
+
+#define GREEN "\033[32m"
+#define RED "\033[31m"
+#define RESET "\033[0m"
+
+/*
+ * Checks the static exchange evaluation on positions with a known outcome.
+ * (with the piece values from eval.h: pawn 100, knight 300, bishop 320, rook 500 and queen 900)
+ */
+
+struct SEETestCase
+{
+    std::string fen;
+    std::string move;
+    int expected;
+};
+
+const std::vector<SEETestCase> testCases = {
+    // undefended pawn
+    {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100},
+    // knight for a pawn after the full exchange (including the queens behind the rook and bishop)
+    {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -200},
+    // queen takes a pawn defended by a pawn
+    {"4k3/3p4/4p3/8/8/8/4Q3/4K3 w - - 0 1", "e2e6", -800},
+    // the second rook recaptures through the first one (x-ray)
+    {"4r1k1/8/4p3/8/8/8/4R3/4R1K1 w - - 0 1", "e2e6", 100},
+    // en passant
+    {"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 100},
+    // capture promotion that is defended by the king
+    {"2kr4/4P3/8/8/8/8/8/K7 w - - 0 1", "e7d8q", 400},
+    // the king can't recapture a defended piece
+    {"8/8/8/8/8/2k5/3p4/3RK3 w - - 0 1", "d1d2", 100},
+    // quiet move to an attacked square
+    {"4k3/8/8/3p4/8/8/8/2Q1K3 w - - 0 1", "c1c4", -900},
+    // black to move
+    {"4k3/8/2n5/8/3P4/8/8/4K3 b - - 0 1", "c6d4", 100},
+};
+
+int main()
+{
+    int failed = 0;
+    for (const SEETestCase &test : testCases)
+    {
+        chess::BoardState board(test.fen);
+
+        bool found = false;
+        for (const chess::Move &m : board.legalMoves())
+        {
+            if (m.toUCI() != test.move)
+                continue;
+
+            found = true;
+            int see = board.staticExchangeEval(m);
+            if (see != test.expected)
+            {
+                std::cout << RED << "SEE of " << test.move << " on " << test.fen << " is " << see
+                          << " expected: " << test.expected << RESET << std::endl;
+                failed++;
+            }
+        }
+
+        if (!found)
+        {
+            std::cout << RED << test.move << " is not a legal move on " << test.fen << RESET << std::endl;
+            failed++;
+        }
+    }
+
+    if (failed != 0)
+    {
+        std::cout << RED << failed << " of " << testCases.size() << " SEE tests failed" << RESET << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN << "All " << testCases.size() << " SEE tests passed" << RESET << std::endl;
+    return 0;
+}
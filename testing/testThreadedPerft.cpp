@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+
+#include "chess.h"
+
+#define GREEN "\033[32m"
+#define RED "\033[31m"
+#define RESET "\033[0m"
+
+/*
+ * Checks that move generation can run on multiple threads at the same time.
+ * We first compute the perft of every position on a single thread and then again with all positions
+ * spread over many threads. If any state is shared between calls the counts will differ.
+ */
+
+using MoveGenType = chess::BoardState::MoveGenType;
+
+uint64_t perft(const chess::BoardState &b, int depth)
+{
+    if (depth == 0)
+        return 1;
+
+    uint64_t nodes = 0;
+    for (const chess::Move &m : b.pseudoLegalMoves<MoveGenType::Legal>())
+    {
+        chess::BoardState newB = b;
+        newB.makeMove(m);
+        nodes += perft(newB, depth - 1);
+    }
+
+    // Also generate the captures so the legal quiescent generation is exercised as well
+    nodes += b.pseudoLegalMoves<MoveGenType::LegalQuiescent>().numMoves;
+
+    return nodes;
+}
+
+// Each thread handles every numThreads'th position
+void perftPositions(const std::vector<chess::BoardState> &boards, int depth,
+                    int threadIdx, int numThreads, std::vector<uint64_t> &results)
+{
+    for (size_t i = threadIdx; i < boards.size(); i += numThreads)
+        results[i] = perft(boards[i], depth);
+}
+
+int main(int argc, char *argv[])
+{
+    // The quick mode is usefull for faster itteration when experimenting with optimizations
+    bool quickMode = false;
+
+    // Loop through command-line arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--quick")
+        {
+            quickMode = true;
+        }
+    }
+
+    std::string fensPath = quickMode ? "testing/fens10.txt" : "testing/fens10000.txt";
+    constexpr int DEPTH = 3;
+
+    std::vector<chess::BoardState> boards;
+    std::ifstream fensFile(fensPath);
+    std::string fen;
+    while (getline(fensFile, fen))
+        boards.emplace_back(fen);
+
+    std::cout << "Computing single threaded perft for " << boards.size() << " positions" << std::endl;
+    std::vector<uint64_t> expected(boards.size());
+    perftPositions(boards, DEPTH, 0, 1, expected);
+
+    int numThreads = std::max(8u, std::thread::hardware_concurrency() * 2);
+    std::cout << "Computing perft on " << numThreads << " threads" << std::endl;
+
+    std::vector<uint64_t> results(boards.size());
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back(perftPositions, std::cref(boards), DEPTH, t, numThreads, std::ref(results));
+
+    for (std::thread &t : threads)
+        t.join();
+
+    int mismatches = 0;
+    for (size_t i = 0; i < boards.size(); i++)
+    {
+        if (results[i] == expected[i])
+            continue;
+
+        mismatches++;
+        std::cout << RED << "Mismatch on " << boards[i].fen() << " expected: " << expected[i]
+                  << " got: " << results[i] << RESET << std::endl;
+    }
+
+    if (mismatches != 0)
+    {
+        std::cout << RED << mismatches << " positions gave different results on multiple threads!" << RESET << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN << "All multithreaded perft results match" << RESET << std::endl;
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <random>
+#include <atomic>
+
+#include "transposition.h"
+
+#define GREEN "\033[32m"
+#define RED "\033[31m"
+#define RESET "\033[0m"
+
+/*
+ * Stress test for the lockless transposition table.
+ * Many threads write and read entries for a large pool of keys in a small table (so many keys share a slot).
+ * Every entry that is written is derived from its key and depth, so whenever get() returns an
+ * occupied entry we can check that it was not corrupted by another thread.
+ */
+
+chess::score expectedEval(chess::key k, uint8_t depth)
+{
+    return chess::score((k ^ (depth * 0x9E3779B97F4A7C15ULL)) % 20000) - 10000;
+}
+
+chess::Move expectedMove(chess::key k)
+{
+    return chess::Move(k & 63, (k >> 6) & 63, chess::PieceType((k >> 12) % 6), (k >> 15) & 1);
+}
+
+struct ThreadResult
+{
+    uint64_t reads = 0;
+    uint64_t hits = 0;
+    uint64_t corrupted = 0;
+};
+
+void hammerTable(chess::TranspositionTable &tt, const std::vector<chess::key> &keys,
+                 int iterations, int seed, ThreadResult &result)
+{
+    std::mt19937_64 rng(seed);
+
+    for (int i = 0; i < iterations; i++)
+    {
+        chess::key k = keys[rng() % keys.size()];
+
+        if (rng() % 2)
+        {
+            uint8_t depth = rng() % 32;
+            constexpr chess::EvalBound bounds[3] = {chess::EvalBound::Lower, chess::EvalBound::Upper, chess::EvalBound::Exact};
+            chess::EvalBound bound = bounds[rng() % 3];
+            tt.set(k, chess::TTEntry(expectedEval(k, depth), depth, bound, expectedMove(k)));
+            continue;
+        }
+
+        result.reads++;
+        chess::TTEntry entry = tt.get(k);
+        if (!entry.occupied())
+            continue;
+
+        result.hits++;
+        bool evalCorrect = entry.eval == expectedEval(k, entry.depth());
+        bool moveCorrect = entry.move == expectedMove(k);
+        if (!evalCorrect || !moveCorrect)
+            result.corrupted++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    // The quick mode is usefull for faster itteration when experimenting with optimizations
+    bool quickMode = false;
+
+    // Loop through command-line arguments
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if (arg == "--quick")
+        {
+            quickMode = true;
+        }
+    }
+
+    int numThreads = std::max(8u, std::thread::hardware_concurrency() * 2);
+    int iterations = quickMode ? 1'000'000 : 20'000'000;
+
+    // 1mb table with many more keys than slots to force collisions between threads
+    chess::TranspositionTable tt(1);
+    std::vector<chess::key> keys(1 << 20);
+    std::mt19937_64 keyRng(42);
+    for (chess::key &k : keys)
+        k = keyRng();
+
+    std::cout << "Hammering the transposition table from " << numThreads << " threads" << std::endl;
+
+    std::vector<ThreadResult> results(numThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; t++)
+        threads.emplace_back(hammerTable, std::ref(tt), std::cref(keys), iterations, t, std::ref(results[t]));
+
+    for (std::thread &t : threads)
+        t.join();
+
+    ThreadResult total;
+    for (const ThreadResult &r : results)
+    {
+        total.reads += r.reads;
+        total.hits += r.hits;
+        total.corrupted += r.corrupted;
+    }
+
+    std::cout << "reads: " << total.reads << ", hits: " << total.hits
+              << ", corrupted: " << total.corrupted << std::endl;
+
+    if (total.corrupted != 0)
+    {
+        std::cout << RED << "Corrupted entries were returned by the transposition table!" << RESET << std::endl;
+        return 1;
+    }
+
+    std::cout << GREEN << "No corrupted entries found" << RESET << std::endl;
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <algorithm>
 
 #include "chess.h"
 #include "toolUtils.h"
@@ -17,6 +18,15 @@ void compareIncrementalZobrist(chess::BoardState &b, int depth)
 
     for (auto m : b.pseudoLegalMoves<NORMAL>())
     {
+        // unmakeMove should give back the exact same board (including the hash and evaluation terms)
+        std::string prevFen = b.fen();
+        chess::key prevHash = b.getHash();
+        chess::EvalState prevEvalState = b.evalState();
+        chess::UndoInfo undo = b.makeMove(m);
+        b.unmakeMove(m, undo);
+        if (b.fen() != prevFen || b.getHash() != prevHash || b.evalState() != prevEvalState)
+            std::cout << "Unmake issue after: " << m.toUCI() << " in " << prevFen << std::endl;
+
         chess::BoardState newB = b;
 
         chess::key prevKey = newB.getHash();
@@ -38,6 +48,12 @@ void compareIncrementalZobrist(chess::BoardState &b, int depth)
             chess::showBoardGUI(b, move);
         }
 
+        // The incrementally updated evaluation terms should match the recomputed ones
+        chess::EvalState incEvalState = newB.evalState();
+        newB.recomputeEvalState();
+        if (newB.evalState() != incEvalState)
+            std::cout << "Evaluation terms issue after: " << m.toUCI() << " in " << b.fen() << std::endl;
+
         if (newB.kingAttacked(!newB.whitesMove()))
             continue;
 
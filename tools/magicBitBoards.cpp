@@ -1,15 +1,11 @@
 #include <iostream>
 #include "bitBoard.h"
-#include "boardVisualizer.h"
 #include "moveConstants.h"
 #include <vector>
 #include <functional>
 #include <random>
 #include <filesystem>
 #include <fstream>
-#include <mutex>
-#include <future>
-#include <regex>
 #include "toolUtils.h"
 #include "types.h"
 #include "masks.h"
@@ -17,35 +13,6 @@
 using bitboard = chess::bitboard;
 using square = chess::square;
 
-struct SquareMagic
-{
-    bitboard blockerMask;
-    uint64_t magic;
-    int arrSize;
-};
-
-void saveMagic(int s, bool rook, SquareMagic magic)
-{
-    static std::mutex fileMutex;
-    std::lock_guard<std::mutex> lock(fileMutex);
-
-    std::string outFile = rook ? "rookMagics.out" : "bishopMagics.out";
-    // Get the current working directory
-    std::filesystem::path currentDir = std::filesystem::current_path();
-    // Combine the current directory with outFile name
-    std::filesystem::path fullPath = currentDir / outFile;
-
-    std::fstream out(fullPath, std::ios::app);
-    if (!out)
-    {
-        std::cerr << "Failed to open file: " << fullPath << std::endl;
-        return;
-    }
-
-    out << "SquareMagic square" << s << " = {" << magic.blockerMask << ", " << magic.magic << ", " << magic.arrSize << "};\n";
-    out.close();
-}
-
 // generates the mask for the blockers
 bitboard blockerMaskBishop(square s)
 {
@@ -214,7 +181,7 @@ std::vector<bitboard> blockerArangements(bitboard blockable)
     std::vector<bitboard> blockerArangements;
 
     int blockedSquares = 0; // each bit corresponds to an index in the blockableSquares vector (1 if blocked 0 if not).
-    while (blockedSquares < 1 << (blockableSquares.size() + 1))
+    while (blockedSquares < 1 << blockableSquares.size())
     {
         bitboard blockers = 0;
         for (int i = 0; i < blockableSquares.size(); i++)
@@ -237,32 +204,62 @@ std::vector<bitboard> blockerArangements(bitboard blockable)
 static std::random_device rd;                                       // Obtain a random seed
 static std::mt19937_64 gen(rd());                                   // 64-bit random number generator
 static std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX); // Distribution between 0 and UINT64_MAX
-thread_local std::vector<uint64_t> foundMagics;
 
-static int maxTriesPerArrSize = 100000;
+// Magics with few set bits are a lot more likely to map without collisions
+uint64_t sparseRandom()
+{
+    return dist(gen) & dist(gen) & dist(gen);
+}
 
-bool tryWithArrSize(int arraySize, const std::vector<std::pair<bitboard, bitboard>> &blockerToMoves, SquareMagic &outMagic)
+// Software version of the BMI2 pext instruction: packs the bits of x selected by mask into the low bits
+uint64_t softwarePext(bitboard x, bitboard mask)
 {
-    std::vector<bitboard> resultingMovesArr(arraySize, 0);
+    uint64_t result = 0;
+    int bit = 0;
+    while (mask)
+    {
+        square s = chess::bitBoards::firstSetBit(mask);
+        if (x & (1ULL << s))
+            result |= 1ULL << bit;
 
-    int totalSuccesfullInsertions = 0;
+        bit++;
+        mask &= mask - 1;
+    }
+    return result;
+}
+
+/*
+ * Finds a magic for which (blockers * magic) >> shift maps every blocker arangement
+ * to an index in [0, 2^bits) where arangements sharing an index have the same moves.
+ * The shift is fixed at 64 - bits, so each square gets a table of 2^bits entries.
+ */
+chess::constants::MagicInfo findShiftMagic(square s,
+                                           std::function<bitboard(square)> getBlockerMask,
+                                           std::function<bitboard(square, bitboard)> getNonBlockedMoves)
+{
+    chess::constants::MagicInfo info;
+    info.mask = getBlockerMask(s);
+    int bits = __builtin_popcountll(info.mask);
+    info.shift = 64 - bits;
 
-    // use the already found magic as a first attempt
-    int foundM = 0;
-    uint64_t magic;
-    if (foundMagics.size() != 0)
-        magic = foundMagics[0];
+    std::vector<std::pair<bitboard, bitboard>> blockerToMoves;
+    for (bitboard blockers : blockerArangements(info.mask))
+        blockerToMoves.emplace_back(blockers, getNonBlockedMoves(s, blockers));
 
-    int tries = 0;
-    while (tries < maxTriesPerArrSize)
+    std::vector<bitboard> resultingMovesArr(1ULL << bits);
+    while (true)
     {
-        tries++;
+        uint64_t magic = sparseRandom();
 
-        bool mappingSuccess = true;
+        // the magic should at least spread the mask over the high bits of the index
+        if (__builtin_popcountll((info.mask * magic) & 0xFF00000000000000ULL) < 6)
+            continue;
 
+        std::fill(resultingMovesArr.begin(), resultingMovesArr.end(), 0);
+        bool mappingSuccess = true;
         for (auto [blockers, legalMoves] : blockerToMoves)
         {
-            int idx = blockers * magic % arraySize;
+            uint64_t idx = (blockers * magic) >> info.shift;
             if (resultingMovesArr[idx] != 0 && resultingMovesArr[idx] != legalMoves)
             {
                 mappingSuccess = false;
@@ -270,206 +267,24 @@ bool tryWithArrSize(int arraySize, const std::vector<std::pair<bitboard, bitboar
             }
 
             resultingMovesArr[idx] = legalMoves;
-            totalSuccesfullInsertions++;
-        }
-
-        int avgUntillCollision = totalSuccesfullInsertions / (tries);
-        if (avgUntillCollision < 400 && tries > 10)
-        {
-            return false;
         }
 
         if (mappingSuccess)
         {
-            outMagic.magic = magic;
-            outMagic.arrSize = arraySize;
-            return true;
-        }
-
-        // Clear out the resultingMovesArr
-        std::fill(resultingMovesArr.begin(), resultingMovesArr.end(), 0);
-
-        foundM++;
-        if (foundM < foundMagics.size())
-            magic = foundMagics[foundM];
-        else
-            // choose a new magic
-            magic = dist(gen);
-    }
-
-    return false;
-}
-static int maxConsequtiveFails = 100000;
-static bool verbose = false;
-SquareMagic generateBlockedMagic(square s,
-                                 std::function<bitboard(square)> getBlockerMask,
-                                 std::function<bitboard(square, bitboard)> getNonBLockedMoves, bool increasedSize = false)
-{
-    SquareMagic generatedMagic;
-    generatedMagic.arrSize = -1;
-    // some initial magic i found.
-    generatedMagic.blockerMask = getBlockerMask(s);
-
-    std::vector<bitboard> allBlockers = blockerArangements(generatedMagic.blockerMask);
-    std::vector<std::pair<bitboard, bitboard>> blockerToMoves;
-    for (bitboard blockers : allBlockers)
-    {
-        blockerToMoves.emplace_back(blockers, getNonBLockedMoves(s, blockers));
-    }
-
-    int arraySize = pow(2, __builtin_popcountll(generatedMagic.blockerMask)) + 1;
-    if (increasedSize)
-        arraySize *= 4 + 1;
-
-    int smallestFoundArraySize = arraySize * 2 + 1;
-    int consequtiveFails = 0;
-    while (consequtiveFails < maxConsequtiveFails)
-    {
-        bool found = tryWithArrSize(arraySize, blockerToMoves, generatedMagic);
-        if (found)
-        {
-            if (verbose)
-                std::cout << "best size: " << arraySize << "(magic: " << generatedMagic.magic << ')' << std::endl;
-
-            smallestFoundArraySize = arraySize;
-            if (std::find(foundMagics.begin(), foundMagics.end(), generatedMagic.magic) == foundMagics.end())
-                foundMagics.push_back(generatedMagic.magic);
-            consequtiveFails = 0;
+            info.magic = magic;
+            return info;
         }
-        else
-        {
-            consequtiveFails++;
-            // If we are too low we can search closer
-            // to the smallest array found thus far.
-            if (arraySize < smallestFoundArraySize * 0.75 && consequtiveFails > 500)
-            {
-                arraySize = smallestFoundArraySize;
-            }
-        }
-
-        // Lower our array size to attempt at a different size (skip even sizes)
-        if (arraySize < 5)
-        {
-            arraySize = smallestFoundArraySize;
-        }
-        arraySize -= 2;
-
-        if (verbose && consequtiveFails % (maxConsequtiveFails / 100) == 0 && consequtiveFails != 0)
-            std::cout << consequtiveFails / (double)maxConsequtiveFails << '%' << std::endl;
-    }
-
-    return generatedMagic;
-}
-
-static int maxRetries = 10;
-
-void generateAndSaveRookMagic(square s, int retries = 0)
-{
-    foundMagics.clear();
-    bool increaseSize = retries > maxRetries / 2;
-    int square = static_cast<int>(s);
-    SquareMagic foundMagic = generateBlockedMagic(s, blockerMaskRook, blockedRookMoves, increaseSize);
-    if (foundMagic.arrSize == -1)
-    {
-        if (retries < maxRetries)
-            generateAndSaveRookMagic(s, retries + 1);
-        else
-            std::cout << "Unable to find magic for square " << square << std::endl;
-    }
-    else
-    {
-        std::cout << "saving square " << square
-                  << " (final size: " << foundMagic.arrSize << ")" << std::endl;
-        saveMagic(s, true, foundMagic);
-    }
-}
-
-void generateRookMagics()
-{
-    std::vector<std::future<void>> futures;
-    for (square s = 0; s < 64; s++)
-    {
-        futures.push_back(std::async(std::launch::async, generateAndSaveRookMagic, s, 0));
-    }
-
-    for (auto &f : futures)
-    {
-        f.get();
-    }
-}
-
-void generateAndSaveBishopMagic(square s, int retries = 0)
-{
-    foundMagics.clear();
-    bool increaseSize = retries > maxRetries / 2;
-    int square = static_cast<int>(s);
-    SquareMagic foundMagic = generateBlockedMagic(s, blockerMaskBishop, blockedBishopMoves, increaseSize);
-    if (foundMagic.arrSize == -1)
-    {
-        if (retries < maxRetries)
-            generateAndSaveBishopMagic(s, retries + 1);
-        else
-            std::cout << "Unable to find magic for square " << square << std::endl;
-    }
-    else
-    {
-        std::cout << "saving square " << square
-                  << " (final size: " << foundMagic.arrSize << ")" << std::endl;
-        saveMagic(s, false, foundMagic);
     }
 }
 
-void generateBishopMagics()
-{
-    std::vector<std::future<void>> futures;
-    for (square s = 0; s < 64; s++)
-    {
-        futures.push_back(std::async(std::launch::async, generateAndSaveBishopMagic, s, 0));
-    }
-
-    for (auto &f : futures)
-    {
-        f.get();
-    }
-}
-
-void testBlockersToMoves(const chess::constants::MagicInfo &m, square s, const std::vector<bitboard> &moveArr)
-{
-    std::vector<bitboard> allBlockers = blockerArangements(m.mask);
-    std::vector<std::pair<bitboard, bitboard>> blockerToMoves;
-    for (bitboard blockers : allBlockers)
-    {
-        blockerToMoves.emplace_back(blockers, blockedRookMoves(s, blockers));
-    }
-
-    std::random_device rd;
-    std::mt19937 gen(rd()); // Mersenne Twister PRNG
-
-    // Define the range for distribution
-    std::uniform_int_distribution<size_t> dist(0, blockerToMoves.size() - 1);
-    auto [blockers, moves] = blockerToMoves[dist(gen)];
-
-    uint32_t idx = m.arrayOffset + ((m.magic * blockers) % m.squareArraySize);
-
-    std::cout << "Off: " << m.arrayOffset << " size: " << m.squareArraySize << " final idx: " << idx << std::endl;
-    chess::bitBoards::showBitboardGUI(blockers, "Blockers");
-    chess::bitBoards::showBitboardGUI(moveArr[idx], "Moves");
-}
-
-void writeMagicArray(chess::constants::MagicInfo (&magics)[64], const std::vector<bitboard> moves, bool rook)
+void writeMagicInfos(chess::constants::MagicInfo (&magics)[64], const std::string &outFile, bool rook)
 {
     std::string piece = rook ? "rook" : "bishop";
 
-    int endIdx = moves.size() - 1;
-    while (moves[endIdx] == 0)
-        endIdx--;
-
-    int finalSize = endIdx + 1;
-
     // Get the current working directory
     std::filesystem::path currentDir = std::filesystem::current_path();
     // Combine the current directory with outFile name
-    std::filesystem::path fullPath = currentDir / "magicMoveArrays.out";
+    std::filesystem::path fullPath = currentDir / outFile;
 
     std::fstream out(fullPath, std::ios::app);
     if (!out)
@@ -488,120 +303,56 @@ void writeMagicArray(chess::constants::MagicInfo (&magics)[64], const std::vecto
         first = false;
 
         out << "{" << m.mask << "ULL, " << m.magic << "ULL, "
-            << m.squareArraySize << "U, " << m.arrayOffset << "U}";
-    }
-    out << "};\n";
-
-    out << "constexpr bitboard " << piece << "NonBlockedMoves" << "[" << finalSize << "] = {";
-    first = true;
-    for (int i = 0; i < finalSize; i++)
-    {
-        if (!first)
-            out << ", ";
-
-        first = false;
-
-        out << moves[i] << "ULL";
+            << (int)m.shift << "U, " << m.arrayOffset << "U}";
     }
     out << "};\n";
     out.close();
-
-    std::cout << "Saved at: " << fullPath << std::endl;
 }
 
-void readMagicsAndCreateArray(bool rooks, bool showTest = false)
+/*
+ * Generates the magics for all squares and writes them together with the two move arrays:
+ *  - <piece>NonBlockedMoves: indexed by arrayOffset + ((blockers * magic) >> shift)
+ *  - <piece>PextMoves: indexed by arrayOffset + pext(blockers, mask) (used when compiled with BMI2)
+ * Both arrays give each square 2^bits entries so they share the same array offsets.
+ */
+void generateMagicsAndArrays(bool rooks)
 {
-    chess::constants::MagicInfo magics[64];
-
-    std::string outFile = rooks ? "rookMagics.out" : "bishopMagics.out";
-    // Get the current working directory
-    std::filesystem::path currentDir = std::filesystem::current_path();
-    // Combine the current directory with outFile name
-    std::filesystem::path fullPath = currentDir / outFile;
-
-    std::ifstream out(fullPath);
-    std::string line;
-
-    int totalArrSize = 0;
+    auto getBlockerMask = rooks ? blockerMaskRook : blockerMaskBishop;
+    auto getNonBlockedMoves = rooks ? blockedRookMoves : blockedBishopMoves;
 
-    std::regex magicFormat("SquareMagic square(\\d+) = \\{(\\d+), (\\d+), (\\d+)\\};");
-    std::smatch regexMatch;
-    while (getline(out, line))
+    chess::constants::MagicInfo magics[64];
+    uint32_t curOffset = 0;
+    for (square s = 0; s < 64; s++)
     {
-        if (std::regex_search(line, regexMatch, magicFormat))
-        {
-            int square = std::stoi(regexMatch[1].str());
-            bitboard mask = std::stoull(regexMatch[2].str());
-            bitboard magic = std::stoull(regexMatch[3].str());
-            int arraySize = std::stoi(regexMatch[4].str());
-            totalArrSize += arraySize;
-
-            magics[square].mask = mask;
-            magics[square].magic = magic;
-            magics[square].squareArraySize = arraySize;
-        }
+        magics[s] = findShiftMagic(s, getBlockerMask, getNonBlockedMoves);
+        magics[s].arrayOffset = curOffset;
+        curOffset += 1U << (64 - magics[s].shift);
     }
 
-    std::cout << "Theoretical array size: " << totalArrSize << std::endl;
-    std::vector<bitboard> legalMoveArray(totalArrSize, 0);
-    int curOffset = 0;
-
+    std::vector<bitboard> magicMoves(curOffset, 0);
+    std::vector<bitboard> pextMoves(curOffset, 0);
     for (square s = 0; s < 64; s++)
     {
-        chess::constants::MagicInfo &m = magics[s];
-        m.arrayOffset = curOffset;
-
-        std::vector<bitboard> allBlockers = blockerArangements(m.mask);
-        std::vector<std::pair<bitboard, bitboard>> blockerToMoves;
-        for (bitboard blockers : allBlockers)
-        {
-            if (rooks)
-                blockerToMoves.emplace_back(blockers, blockedRookMoves(s, blockers));
-            else
-                blockerToMoves.emplace_back(blockers, blockedBishopMoves(s, blockers));
-        }
-
-        for (auto [blockers, moves] : blockerToMoves)
+        const chess::constants::MagicInfo &m = magics[s];
+        for (bitboard blockers : blockerArangements(m.mask))
         {
-            uint32_t idx = m.arrayOffset + (blockers * m.magic) % m.squareArraySize;
-            legalMoveArray[idx] = moves;
+            bitboard moves = getNonBlockedMoves(s, blockers);
+            magicMoves[m.arrayOffset + ((blockers * m.magic) >> m.shift)] = moves;
+            pextMoves[m.arrayOffset + softwarePext(blockers, m.mask)] = moves;
         }
-
-        curOffset += m.squareArraySize;
-        // start the new array on the first location without a board in it.
-        while (legalMoveArray[curOffset] == 0)
-            curOffset--;
-        curOffset++;
     }
 
-    int endIdx = legalMoveArray.size() - 1;
-    while (legalMoveArray[endIdx] == 0)
-        endIdx--;
-
-    std::cout << "Final array size: " << endIdx + 1 << std::endl;
+    std::cout << (rooks ? "Rook" : "Bishop") << " array size: " << curOffset << std::endl;
 
-    writeMagicArray(magics, legalMoveArray, rooks);
-
-    if (showTest)
-    {
-        for (square s = 0; s < 64; s++)
-            testBlockersToMoves(magics[s], s, legalMoveArray);
-    }
+    std::string piece = rooks ? "rook" : "bishop";
+    writeMagicInfos(magics, "magicMoveArrays.out", rooks);
+    writeArray(magicMoves, "magicMoveArrays.out", piece + "NonBlockedMoves");
+    writeArray(pextMoves, "magicMoveArrays.out", piece + "PextMoves");
 }
 
 int main()
 {
-    // generateAndSaveRookMagic(0, 4);
-    // generateAndSaveRookMagic(7, 4);
-    // generateRookMagics();
-    // readMagicsAndCreateArray(true, true);
-
-    // the bishop array is smaller so we can get away with doing more attemps
-    // maxConsequtiveFails = 1000000;
-    // maxTriesPerArrSize = 1000000;
-    // generateBishopMagics();
-
     clearFile("magicMoveArrays.out");
-    readMagicsAndCreateArray(true, false);
-    readMagicsAndCreateArray(false, false);
-}
\ No newline at end of file
+    generateMagicsAndArrays(true);
+    generateMagicsAndArrays(false);
+}